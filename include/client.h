@@ -49,12 +49,24 @@
 #include "particle_scene_node.h"
 #include "timer.h"
 #include "sender.h"
+#include "worker_pool.h"
 
 #define VC_DGRAM_SEC_DTLS		1
 #define VC_MAKE_SCREENCAST		2
+#define VC_HEADLESS				4	/* Receiver without display */
+#define VC_VIRTUAL_CLOCK		8	/* Sender starts next frame, when previous one was sent */
+#define VC_WAKEUP_LATENCY		16	/* Record wake-up latency of threads driven by timer */
 
 #define DEFAULT_FPS	25
 
+#define DEFAULT_PUMP_INTERVAL	1000	/* Microseconds between updates of callbacks */
+
+#define DEFAULT_SESSION_COUNT	1
+#define MAX_SESSION_COUNT		255		/* ID of Verse session is uint8 */
+
+/* Context of i-th Verse session (client itself, when it has only one session) */
+#define CLIENT_SESSION(ctx, i)	(((ctx)->sessions != NULL) ? &(ctx)->sessions[(i)] : (ctx))
+
 /**
  * Type of client (sender/receiver)
  */
@@ -72,11 +84,13 @@ typedef struct VerseData {
 	uint8						session_id;
 	uint32						avatar_id;
 	uint16						user_id;
+	uint8						connected;
 	struct ParticleSceneNode	*particle_scene_node;
 	struct LookUp_Table			*lu_table;
 	uint32						fps;
 	char						*username;
 	char						*password;
+	uint8						auth_attempts;	/* Number of authentication attempts of this session */
 } VerseData;
 
 /**
@@ -91,9 +105,32 @@ typedef struct Client_CTX {
 	struct VListBase			senders;			/* List of particle senders that are in scene */
 	struct Particle_Sender		*sender;			/* Particle sender of this client that sends particles */
 	uint32						sender_count;		/* Cached number of particle senders */
+	uint16						worker_count;		/* Number of threads sending particles */
+	struct WorkerPool			*worker_pool;		/* Pool of threads sending particles */
+	uint32						pump_interval;		/* Interval of callback pumping (0: once per frame) */
+	pthread_t					pump_thread;		/* Thread calling callbacks */
 	pthread_t					timer_thread;		/* Thread with timer */
-	sem_t						timer_sem;
+	sem_t						frame_sem;			/* Frame was sent (virtual clock) */
+	real32						time_scale;			/* Multiplier of frame rate of timer */
 	pthread_t					receiver_thread;
+	pthread_t					ingest_thread;		/* Thread applying received data */
+	sem_t						ingest_sem;
+	pthread_t					stats_thread;		/* Thread exporting statistics */
+	char						*stats_file;		/* File with exported statistics */
+	uint8						jitter_depth;		/* Depth of jitter buffer in frames (0: none) */
+	uint8						jitter_adaptive;	/* Is depth of jitter buffer adaptive? */
+	uint16						predict_frames;		/* Horizon of prediction of lost positions (0: none) */
+	real32						smoothing;			/* Smoothing factor of displayed positions */
+	struct Client_CTX			*sessions;			/* Array of Verse sessions (load generator) */
+	uint16						session_count;		/* Number of Verse sessions */
+	int16						timer_offset;		/* Frame offset of animation in this session */
+	struct ReceivedParticleData	*rec_pd_pool;		/* Received data of destroyed sender nodes */
+	real32						interest_radius;	/* Receive only senders closer to camera (0: all) */
+	uint8						interest_frustum;	/* Receive only senders in view frustum */
+	char						*timer_cpus;		/* CPUs of timer thread (NULL: not pinned) */
+	char						*network_cpus;		/* CPUs of threads sending/receiving data */
+	char						*main_cpus;			/* CPUs of display or statistics of receiver */
+	uint8						rt_priority;		/* SCHED_FIFO priority of timer (0: default) */
 } Client_CTX;
 
 #endif /* CLIENT_H_ */
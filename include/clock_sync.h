@@ -0,0 +1,86 @@
+/*
+ * $Id$
+ *
+ * ***** BEGIN BSD LICENSE BLOCK *****
+ *
+ * Copyright (c) 2009-2011, Jiri Hnidek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ***** END BSD LICENSE BLOCK *****
+ *
+ * Authors: Jiri Hnidek <jiri.hnidek@tul.cz>
+ *
+ */
+
+#ifndef CLOCK_SYNC_H_
+#define CLOCK_SYNC_H_
+
+#include "types.h"
+
+/* Number of last samples filtered by minimal round trip time */
+#define CLOCK_SYNC_SAMPLES		8
+
+/* Interval between time requests sent to one sender (microseconds) */
+#define CLOCK_SYNC_PERIOD		1000000
+
+/**
+ * One exchange of time request and response
+ */
+typedef struct ClockSample {
+	int64			offset;			/* Offset of sender clock to receiver clock */
+	uint64			rtt;			/* Round trip time without processing at sender */
+	uint64			time;			/* Time of receiving response */
+} ClockSample;
+
+/**
+ * Estimation of offset and drift of sender clock (NTP style). Samples are
+ * updated only by thread calling Verse callbacks. Estimated values are
+ * stored atomically, so they could be read by other threads.
+ */
+typedef struct ClockSync {
+	uint64				request_time;	/* Time of pending request (0: none) */
+	uint64				last_request;	/* Time of last sent request */
+	struct ClockSample	samples[CLOCK_SYNC_SAMPLES];
+	uint8				sample_count;
+	uint8				next_sample;
+	int64				first_offset;	/* The first estimated offset used for drift */
+	uint64				first_time;
+	int64				offset;			/* Estimated offset (sender - receiver) */
+	uint32				rtt;			/* Round trip time of sample used for offset */
+	real32				drift;			/* Drift of sender clock in ppm */
+	uint8				valid;			/* Is offset estimated? */
+} ClockSync;
+
+struct Client_CTX;
+
+void clock_sync_init(struct ClockSync *sync);
+int clock_sync_request(struct ClockSync *sync,
+		const uint64 now);
+int clock_sync_response(struct ClockSync *sync,
+		const uint64 times[3],
+		const uint64 now);
+void update_clock_sync(struct Client_CTX *ctx);
+
+#endif /* CLOCK_SYNC_H_ */
@@ -59,6 +59,7 @@ static const uint8 yellow_col[3] = {255, 255, 0};
 static const uint8 yellow_col_a[4] = {255, 255, 0, 150};
 static const uint8 green_col[3] = {0, 200, 0};
 static const uint8 green_col_a[4] = {0, 200, 0, 150};
+static const uint8 blue_col[3] = {80, 160, 255};
 
 /**
  * Information about surface
@@ -121,6 +122,14 @@ typedef struct Canvas {
 	float	line_width;
 } Canvas;
 
+/**
+ * Smoothed position of predicted particle
+ */
+typedef struct DisplayParticle {
+	real32	pos[3];
+	uint8	valid;
+} DisplayParticle;
+
 /**
  * All information required to display basic scene
  */
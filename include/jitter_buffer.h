@@ -0,0 +1,88 @@
+/*
+ * $Id$
+ *
+ * ***** BEGIN BSD LICENSE BLOCK *****
+ *
+ * Copyright (c) 2009-2011, Jiri Hnidek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ***** END BSD LICENSE BLOCK *****
+ *
+ * Authors: Jiri Hnidek <jiri.hnidek@tul.cz>
+ *
+ */
+
+#ifndef JITTER_BUFFER_H_
+#define JITTER_BUFFER_H_
+
+#include "types.h"
+
+/* Maximal depth of jitter buffer in frames */
+#define MAX_JITTER_DEPTH	32
+
+/**
+ * Received state waiting in jitter buffer
+ */
+typedef struct JitterEntry {
+	uint16		item_id;
+	int16		arrival_frame;		/* Frame, when state was received */
+} JitterEntry;
+
+/**
+ * Jitter buffer holding received states of particles until the timer reaches
+ * frame of state + depth. States are released in frame order. Each slot of
+ * buffer contains states of one frame.
+ */
+typedef struct JitterBuffer {
+	uint8				depth;			/* Current depth in frames (0: disabled) */
+	uint8				max_depth;		/* Maximal depth of adaptive buffer */
+	uint8				adaptive;		/* Is depth driven by estimated jitter? */
+	uint16				slot_count;		/* Number of slots (frames) in buffer */
+	uint16				slot_size;		/* Capacity of one slot (particle count) */
+	int16				*slot_frames;	/* Frame of states in slot (-1: empty slot) */
+	uint16				*slot_counts;	/* Number of states in slot */
+	struct JitterEntry	*entries;		/* Array of slot_count*slot_size entries */
+	uint32				occupancy;		/* Number of states in buffer */
+	int32				released_frame;	/* The last released frame */
+	int32				last_transit;	/* Transit time of previous state (frames) */
+	uint32				jitter;			/* Estimated jitter in 1/16 of frame */
+} JitterBuffer;
+
+struct ReceivedParticleData;
+
+int create_jitter_buffer(struct JitterBuffer *jb,
+		const uint16 particle_count,
+		const uint8 depth,
+		const uint8 adaptive);
+void free_jitter_buffer(struct JitterBuffer *jb);
+void clear_jitter_buffer(struct JitterBuffer *jb);
+void jitter_buffer_push(struct ReceivedParticleData *rpd,
+		const uint16 item_id,
+		const int16 ref_frame,
+		const int16 arrival_frame);
+void jitter_buffer_release(struct ReceivedParticleData *rpd,
+		const int16 current_frame);
+
+#endif /* JITTER_BUFFER_H_ */
@@ -43,6 +43,8 @@
 
 void cartesion_to_spherical(real32 cart[3], real32 spher[3]);
 void spherical_to_cartesian(real32 spher[3], real32 cart[3]);
+void vector_cross(real32 a[3], real32 b[3], real32 res[3]);
+real32 vector_normalize(real32 vec[3]);
 
 typedef struct HSV_Color {
 	float h, s, v;
@@ -53,9 +53,16 @@
 #define PARTICLE_COUNT_TAG		303
 #define SENDER_ID_TAG			304
 #define PARTICLE_ID_TAG			305
+#define PARTICLE_LOOP_TAG		306
+#define FRAME_TIME_TAG			307
 
 /* Custom type of layers */
 #define PARTICLE_POS_LAYER		400
+#define TIME_REQUEST_LAYER		401	/* Item of each receiver: avatar ID */
+#define TIME_RESPONSE_LAYER		402	/* Item of each receiver: avatar ID */
+
+/* Item of particle layer with frame and loop of layer content */
+#define SYNC_MARKER_ITEM		65535
 
 /**
  * This structure contains informations about verse node.
@@ -40,6 +40,16 @@
 #include <verse.h>
 
 #include "types.h"
+#include "spsc_ring.h"
+#include "receiver_stats.h"
+#include "jitter_buffer.h"
+#include "clock_sync.h"
+
+/* Capacity of ring with received records in frames of particle system */
+#define INGEST_RING_FRAMES	4
+
+/* Frame rate of reference particle data (velocity is in units per second) */
+#define REF_PARTICLE_FPS	25
 
 typedef enum Particle_State {
 	PARTICLE_STATE_RESERVED	= 0,
@@ -76,6 +86,8 @@ typedef struct RefParticleData {
 	uint16					particle_count;	/* Count of particles in particle system */
 	uint16					frame_count;	/* Duration of particle system in frames */
 	struct RefParticle		*particles;		/* Array of particles */
+	uint16					*active_counts;	/* Number of active particles at each frame */
+	real32					radius;			/* Radius of sphere bounding all active particles */
 } RefParticleData;
 
 
@@ -87,39 +99,149 @@ typedef enum Received_State {
 	RECEIVED_STATE_AHEAD		= 4
 } Received_State;
 
-/**
- * Structure holding information about one received state
- */
-typedef struct ReceivedParticleState {
-	enum Received_State			state;
-	int16						delay;
-	int16						received_frame;
-	struct RefParticleState		*ref_particle_state;
-} ReceivedParticleState;
+/* Received states are packed to 2 bits (state - RECEIVED_STATE_UNRECEIVED) */
+#define RECEIVED_STATE_BITS		2
+#define RECEIVED_STATE_MASK		0x3
+#define STATES_PER_WORD			(64 / RECEIVED_STATE_BITS)
+/* Mask of lower bit of each packed state in one word */
+#define RECEIVED_LOW_BITS		0x5555555555555555ULL
 
 /**
- * Structure holding information about received particle
+ * Structure holding information about received particle. Received states of
+ * particle are stored in packed arrays of ReceivedParticleData.
  */
 typedef struct ReceivedParticle {
-	struct ReceivedParticleState	*first_received_state;
-	struct ReceivedParticleState	*last_received_state;
-	struct ReceivedParticleState	*current_received_state;
-	struct ReceivedParticleState	*received_states;
+	int16							first_frame;	/* The first received frame (-1: none) */
+	int16							last_frame;		/* The last received frame (-1: none) */
+	int16							current_frame;	/* Currently received frame (-1: none) */
 	struct RefParticle				*ref_particle;
 } ReceivedParticle;
 
 /**
- * Structure containing received particle data
+ * Result of prediction of particle position
+ */
+typedef enum Predict_Result {
+	PREDICT_NONE			= 0,	/* Position can't be predicted */
+	PREDICT_RECEIVED		= 1,	/* State of frame was received */
+	PREDICT_INTERPOLATED	= 2,	/* Position interpolated between received states */
+	PREDICT_EXTRAPOLATED	= 3		/* Position extrapolated with velocity */
+} Predict_Result;
+
+/* Number of buffers used for publishing received data to renderer */
+#define RENDER_BUFFER_COUNT	3
+/* Flag of middle buffer, which was published and not read yet */
+#define RENDER_BUFFER_FRESH	0x80
+
+/**
+ * Compact copy of received particle used by renderer
+ */
+typedef struct RenderParticle {
+	int16						cur_frame;		/* Frame of current received state (-1: none) */
+	int16						last_frame;		/* Frame of last received state (-1: none) */
+	uint8						cur_state;		/* Received state of current received state */
+} RenderParticle;
+
+/**
+ * Snapshot of received particle data published to renderer
+ */
+typedef struct RenderSnapshot {
+	int16						rec_frame;
+	struct RenderParticle		*particles;
+} RenderSnapshot;
+
+/**
+ * Structure containing received particle data. It is updated only by ingest
+ * worker owning its shard, so it is not locked. Renderer reads current frame
+ * from published snapshot, but history (packed states and received positions
+ * used for prediction) is not part of snapshot and renderer reads it directly.
  */
 typedef struct ReceivedParticleData {
-	pthread_mutex_t				mutex;
 	int16						rec_frame;
+	int32						loop;			/* Number of received animation loop */
+	uint16						generation;		/* Current generation of received states */
 	struct ReceivedParticle		*received_particles;
+	uint16						row_words;		/* Number of words with states of one frame */
+	uint64						*states;		/* Packed 2-bit states [frame][particle] */
+	uint16						*row_gens;		/* Generation of states of each frame */
+	int16						*delays;		/* Delays of received states [frame][particle] */
 	struct RefParticleData		*ref_particle_data;
+	struct SPSC_Ring			*ingest_ring;	/* Records received by callbacks */
+	uint32						shard;			/* Ingest worker consuming ring (modulo count of workers) */
+	uint32						ingest_drops;	/* Number of records dropped due to full ring */
+	struct ReceiverStats		stats;			/* Statistics of received states */
+	uint32						binding;		/* Sequence of bindings to sender nodes (odd: stats are being reset) */
+	struct JitterBuffer			jitter;			/* Buffer reordering received states */
+	int16						checked_frame;	/* Frame, when prediction was checked */
+	int16						sync_frame;		/* Frame of layer snapshot in current loop (-1: none) */
+	struct IngestRecord			*sync_values;	/* Values received before marker of snapshot */
+	uint32						sync_count;		/* Number of values waiting for marker */
+	uint32						sync_max_count;	/* Capacity of values waiting for marker */
+	uint64						*frame_times;	/* Time of sending of each frame (sender clock) */
+	struct ClockSync			clock;			/* Estimation of sender clock */
+	struct RenderSnapshot		render[RENDER_BUFFER_COUNT];	/* Triple buffer of snapshots */
+	uint8						render_back;	/* Buffer written by publisher */
+	uint8						render_middle;	/* Buffer swapped by publisher and renderer */
+	uint8						render_front;	/* Buffer read by renderer */
+	struct ReceivedParticleData	*next;			/* Next unused data in pool */
 } ReceivedParticleData;
 
+typedef enum Ingest_Type {
+	INGEST_SET_VALUE	= 1,
+	INGEST_UNSET_VALUE	= 2,
+	INGEST_FRAME		= 3,
+	INGEST_LOOP			= 4,
+	INGEST_RESET		= 5,	/* Sender entered interest again */
+	INGEST_SYNC_VALUE	= 6,	/* Value of layer sent after subscription */
+	INGEST_FRAME_TIME	= 7,	/* Time of sending frame (sender clock) */
+	INGEST_BIND			= 8,	/* Data were bound to new sender node */
+	INGEST_SYNC_MARK	= 9		/* Frame and loop of layer snapshot */
+} Ingest_Type;
+
+/**
+ * Compact record about received data passed from Verse callbacks to thread
+ * updating received particle data
+ */
+typedef struct IngestRecord {
+	uint8						type;
+	uint16						item_id;
+	int16						frame;			/* Frame of arrival or received frame/loop */
+	uint16						loop;			/* Loop of received frame */
+	real32						pos[3];
+	uint64						time;			/* Time of arrival or received time of frame */
+} IngestRecord;
+
 struct Client_CTX;
 
+/**
+ * \brief This function returns received state of particle at frame. States of
+ * frame stored in older generation (previous loop of animation) are
+ * unreceived. It could be called without locking.
+ */
+static inline enum Received_State get_received_state(struct ReceivedParticleData *rpd,
+		const uint16 generation,
+		const uint16 item_id,
+		const int16 frame)
+{
+	uint64 word;
+
+	if(__atomic_load_n(&rpd->row_gens[frame], __ATOMIC_ACQUIRE) != generation) {
+		return RECEIVED_STATE_UNRECEIVED;
+	}
+
+	word = __atomic_load_n(&rpd->states[frame*rpd->row_words + item_id/STATES_PER_WORD], __ATOMIC_RELAXED);
+
+	return (enum Received_State)(RECEIVED_STATE_UNRECEIVED +
+			((word >> ((item_id % STATES_PER_WORD)*RECEIVED_STATE_BITS)) & RECEIVED_STATE_MASK));
+}
+
+/**
+ * \brief This function returns current generation of received particle data
+ */
+static inline uint16 get_received_generation(struct ReceivedParticleData *rpd)
+{
+	return __atomic_load_n(&rpd->generation, __ATOMIC_RELAXED);
+}
+
 void free_ref_particle_data(struct RefParticleData *pd);
 struct RefParticleData *read_ref_particle_data(char *dir_name);
 
@@ -127,8 +249,41 @@ struct RefParticleState *find_ref_particle_state(struct RefParticleData *pd,
 		struct RefParticle *ref_particle,
 		const int16 frame,
 		const real32 pos[3]);
+void set_received_state(struct ReceivedParticleData *rpd,
+		const uint16 item_id,
+		const int16 frame,
+		const enum Received_State state);
+uint32 received_count_in_frame(struct ReceivedParticleData *rpd,
+		const uint16 generation,
+		const int16 frame);
 void reset_received_particle_data(struct ReceivedParticleData *rpd);
+void unset_received_particle(struct ReceivedParticleData *rpd,
+		const uint16 item_id);
+void update_received_particle_state(struct ReceivedParticleData *rpd,
+		const uint16 item_id,
+		const int16 ref_frame,
+		const int16 arrival_frame,
+		const uint8 buffered);
+int apply_received_particle_state(struct ReceivedParticleData *rpd,
+		const uint16 item_id,
+		const int16 current_frame,
+		const uint64 arrival_time,
+		const real32 pos[3]);
+void seed_received_particle_state(struct ReceivedParticleData *rpd,
+		const uint16 item_id,
+		const int16 frame);
+int predict_received_particle(struct ReceivedParticleData *rpd,
+		const uint16 item_id,
+		const int16 frame,
+		const uint16 horizon,
+		real32 pos[3]);
+void publish_received_particle_data(struct ReceivedParticleData *rpd);
+struct RenderSnapshot *read_received_particle_data(struct ReceivedParticleData *rpd);
 struct ReceivedParticleData *create_received_particle_data(struct Client_CTX *ctx);
 void free_received_particle_data(struct ReceivedParticleData *rpd);
+struct ReceivedParticleData *acquire_received_particle_data(struct Client_CTX *ctx);
+void release_received_particle_data(struct Client_CTX *ctx,
+		struct ReceivedParticleData *rpd);
+void free_received_particle_data_pool(struct Client_CTX *ctx);
 
 #endif /* PARTICLE_DATA_H_ */
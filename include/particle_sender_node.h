@@ -44,6 +44,12 @@
 #include "sender.h"
 #include "particle_scene_node.h"
 
+/* Synchronization of layer with particles after subscription */
+#define LAYER_SYNC_NONE		0	/* Layer is not subscribed */
+#define LAYER_SYNC_WAIT		1	/* Layer was subscribed, waiting for its content */
+#define LAYER_SYNC_SNAPSHOT	2	/* Receiving content of layer, its marker wasn't received yet */
+#define LAYER_SYNC_LIVE		3	/* Marker of snapshot was received, receiving updates of layer */
+
 /**
  * This structure contains informations about node, that is parent of all
  * nodes representing particles.
@@ -57,7 +63,13 @@ typedef struct ParticleSenderNode {
 	uint16						pos_tag_id;				/* ID of Tag with sender position */
 	uint16						count_tag_id;			/* ID of Tag containing number of particles */
 	uint16						sender_id_tag_id;		/* ID of Tag containing ID of sender */
+	uint16						loop_tag_id;			/* ID of Tag with number of animation loop */
+	uint16						frame_time_tag_id;		/* ID of Tag with frame and time of its sending */
 	uint16						particle_layer_id;		/* ID of Layer containing positions fo particles */
+	uint16						time_req_layer_id;		/* ID of Layer with time requests of receivers */
+	uint16						time_resp_layer_id;		/* ID of Layer with time responses of sender */
+	uint8						layer_subscribed;		/* Is receiver subscribed to layer with particles? */
+	uint8						layer_sync;				/* Synchronization of layer with particles */
 	struct VListBase			particles;				/* Linked list with particles */
 	struct ParticleSceneNode	*scene;
 	struct Particle_Sender		*sender;
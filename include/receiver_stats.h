@@ -0,0 +1,120 @@
+/*
+ * $Id$
+ *
+ * ***** BEGIN BSD LICENSE BLOCK *****
+ *
+ * Copyright (c) 2009-2011, Jiri Hnidek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ***** END BSD LICENSE BLOCK *****
+ *
+ * Authors: Jiri Hnidek <jiri.hnidek@tul.cz>
+ *
+ */
+
+#ifndef RECEIVER_STATS_H_
+#define RECEIVER_STATS_H_
+
+#include "types.h"
+
+/* Histogram has 2^HIST_SUB_BUCKET_BITS linear sub-buckets in each power of two */
+#define HIST_SUB_BUCKET_BITS	4
+#define HIST_SUB_BUCKET_COUNT	(1 << HIST_SUB_BUCKET_BITS)
+#define HIST_BUCKET_COUNT		((32 - HIST_SUB_BUCKET_BITS + 1) * HIST_SUB_BUCKET_COUNT)
+
+/* Interval of printing and exporting statistics (seconds) */
+#define STATS_INTERVAL		1
+
+/**
+ * Log-linear (HDR style) histogram of unsigned values. Relative error of
+ * value stored in bucket is at most 1/HIST_SUB_BUCKET_COUNT.
+ */
+typedef struct StatsHistogram {
+	uint32		total;			/* Number of values in histogram */
+	uint32		max;			/* Maximal value */
+	uint32		counts[HIST_BUCKET_COUNT];
+} StatsHistogram;
+
+/**
+ * Statistics of particles received from one sender. Counters are only
+ * incremented by ingest thread and they can be read by other threads without
+ * locking. They are reset only, when received data are bound to new sender
+ * node (INGEST_BIND). Ingest thread makes binding sequence odd during reset
+ * and even again after it. Reader discards copy, when sequence was odd, and
+ * it starts new interval, when sequence changed.
+ */
+typedef struct ReceiverStats {
+	uint32					expected;	/* Number of states sent by sender */
+	uint32					received;	/* Number of received states */
+	uint32					intime;		/* Number of states received in time */
+	uint32					late;		/* Number of delayed states */
+	uint32					ahead;		/* Number of states received ahead of time */
+	struct StatsHistogram	delay;		/* Delay of received states in frames */
+	struct StatsHistogram	ahead_hist;	/* Number of frames, when state was received ahead */
+	struct StatsHistogram	loss;		/* Lengths of bursts of lost states in frames */
+	struct StatsHistogram	reorder;	/* Distance of states received out of order in frames */
+	struct StatsHistogram	jitter_occupancy;	/* Number of states in jitter buffer at frame boundaries */
+	uint32					jitter_late_drops;	/* States dropped, because their frame was released */
+	uint32					jitter_overflows;	/* States applied without buffering */
+	uint32					jitter_depth;		/* Current depth of jitter buffer in frames */
+	struct StatsHistogram	predict_error;		/* Error of predicted positions (1/1000 of unit) */
+	uint32					interpolated;		/* Number of interpolated positions */
+	uint32					extrapolated;		/* Number of extrapolated positions */
+	uint32					unpredicted;		/* Number of lost positions, which can't be predicted */
+	struct StatsHistogram	latency;	/* One-way delay of received states in microseconds */
+	uint32					drops;		/* Records dropped due to full ingest ring (copy) */
+	int32					last_tot_frame;	/* Last frame added to expected states */
+} ReceiverStats;
+
+struct RefParticleData;
+struct Client_CTX;
+
+void stats_hist_add(struct StatsHistogram *hist, const uint32 value);
+void stats_hist_copy(struct StatsHistogram *dst, struct StatsHistogram *src);
+void stats_hist_merge(struct StatsHistogram *dst, struct StatsHistogram *src);
+void stats_hist_diff(struct StatsHistogram *dst,
+		const struct StatsHistogram *cur,
+		const struct StatsHistogram *prev);
+uint32 stats_hist_percentile(struct StatsHistogram *hist, const real32 percentile);
+
+void receiver_stats_init(struct ReceiverStats *stats);
+void receiver_stats_add_state(struct ReceiverStats *stats,
+		const uint8 state,
+		const int16 delay,
+		const int32 last_frame,
+		const int32 frame);
+void receiver_stats_add_latency(struct ReceiverStats *stats,
+		const uint64 latency);
+void receiver_stats_add_frames(struct ReceiverStats *stats,
+		struct RefParticleData *pd,
+		const int32 tot_frame);
+void receiver_stats_add_prediction(struct ReceiverStats *stats,
+		const int result,
+		const real32 error);
+void receiver_stats_copy(struct ReceiverStats *dst,
+		struct ReceiverStats *src);
+void *receiver_stats_loop(void *arg);
+
+#endif /* RECEIVER_STATS_H_ */
@@ -54,6 +54,12 @@ typedef struct Particle_Sender {
 	struct Timer				*timer;
 	uint16						id;
 	real32						pos[3];
+	uint32						sent_cmd_count;	/* Number of commands sent by this sender */
+	uint8						attached;		/* Is sender attached to sending thread? */
+	int32						loop;			/* Number of last sent animation loop */
+	uint8						*set_items;		/* Items of layer set on server by sender */
+	struct DisplayParticle		*display_particles;	/* Smoothed positions drawn by receiver */
+	uint8						interest;		/* Is sender in interest of receiver? */
 } Particle_Sender;
 
 void create_senders(struct Client_CTX *ctx);
@@ -0,0 +1,65 @@
+/*
+ * $Id$
+ *
+ * ***** BEGIN BSD LICENSE BLOCK *****
+ *
+ * Copyright (c) 2009-2011, Jiri Hnidek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ***** END BSD LICENSE BLOCK *****
+ *
+ * Authors: Jiri Hnidek <jiri.hnidek@tul.cz>
+ *
+ */
+
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include "types.h"
+
+#define CACHE_LINE_SIZE		64
+
+/**
+ * Lock-free ring buffer for exactly one producer thread and exactly one
+ * consumer thread. Items have fixed size and they are copied in/out.
+ */
+typedef struct SPSC_Ring {
+	uint32		head;		/* Index of next written item (written only by producer) */
+	uint8		pad1[CACHE_LINE_SIZE - sizeof(uint32)];
+	uint32		tail;		/* Index of next read item (written only by consumer) */
+	uint8		pad2[CACHE_LINE_SIZE - sizeof(uint32)];
+	uint32		size;		/* Capacity of ring (power of two) */
+	uint32		mask;		/* size - 1 */
+	uint16		item_size;	/* Size of one item in bytes */
+	uint8		*items;		/* Array of items */
+} SPSC_Ring;
+
+struct SPSC_Ring *spsc_ring_create(uint32 capacity, uint16 item_size);
+void spsc_ring_free(struct SPSC_Ring *ring);
+int spsc_ring_push(struct SPSC_Ring *ring, const void *item);
+int spsc_ring_pop(struct SPSC_Ring *ring, void *item);
+uint32 spsc_ring_count(struct SPSC_Ring *ring);
+
+#endif /* SPSC_RING_H_ */
@@ -38,20 +38,78 @@
 #define TIMER_H_
 
 #include "types.h"
+#include "receiver_stats.h"
 
 #define ONE_SECOND		1000000
+#define ONE_SECOND_NSEC	1000000000
 
 #define START_TOT_FRAME	0
 #define END_TOT_FRAME	300
 
+/**
+ * Timer of sender. All timers advance with one global tick of timer thread,
+ * so timer stores only tick, when its total frame was zero. Frames are
+ * computed from global tick, when timer is read.
+ */
 typedef struct Timer {
-	pthread_mutex_t	mutex;		/* Thread mutex used for synchronization */
-	int16			frame;		/* Frame that is inside of animation range */
-	int16			tot_frame;	/* Total frame of timer */
+	pthread_mutex_t	mutex;		/* Thread mutex used for synchronization of writers */
+	uint16			frame_count;	/* Number of frames of animation */
+	uint32			start;		/* Global tick of total frame zero */
 	uint8			run;		/* Is animation running? */
+	uint64			snapshot;	/* Packed copy of values above for readers without lock */
 } Timer;
 
-struct Timer *create_timer(void);
+/**
+ * Consistent copy of timer values read without locking of mutex
+ */
+typedef struct TimerSnapshot {
+	int16			frame;
+	int32			tot_frame;
+	uint8			run;
+} TimerSnapshot;
+
+/**
+ * Statistics of ticks of timer thread. They are updated only by timer thread.
+ */
+typedef struct TimerStats {
+	uint32					ticks;		/* Number of ticks */
+	uint32					missed;		/* Number of frames skipped by late ticks */
+	struct StatsHistogram	lateness;	/* Lateness of ticks in microseconds */
+} TimerStats;
+
+#define MAX_TICK_CONSUMERS	8
+
+/**
+ * Consumer of ticks broadcasted by timer thread. Ticks missed by consumer are
+ * coalesced into one wake-up. Counters are updated only by consumer.
+ */
+typedef struct TickConsumer {
+	const char				*name;		/* Name of consumer in statistics */
+	uint32					last_seq;	/* Last tick sequence seen by consumer */
+	uint32					last_tick;	/* Last frame tick seen by consumer */
+	uint32					wakeups;	/* Number of wake-ups */
+	uint32					coalesced;	/* Number of ticks coalesced with next one */
+	struct StatsHistogram	lag;		/* Ticks missed before wake-up */
+	struct StatsHistogram	wakeup;		/* Latency of wake-up after tick in microseconds */
+	/* Values of last printed statistics (used only by printing thread) */
+	uint32					prev_wakeups;
+	uint32					prev_coalesced;
+	struct StatsHistogram	prev_lag;
+	struct StatsHistogram	prev_wakeup;
+} TickConsumer;
+
+void tick_consumer_init(struct TickConsumer *consumer, const char *name);
+uint32 tick_consumer_wait(struct TickConsumer *consumer);
+uint32 tick_consumer_poll(struct TickConsumer *consumer);
+
+struct Timer *create_timer(const uint16 frame_count);
+void timer_publish(struct Timer *timer);
+void timer_read(struct Timer *timer, struct TimerSnapshot *snapshot);
+void timer_start(struct Timer *timer, int16 tot_frame);
+void timer_stop(struct Timer *timer);
+uint64 timer_get_usec(void);
+void timer_stats_read(struct TimerStats *stats);
+void timer_stats_print(void);
 void *timer_loop(void *arg);
 
 #endif /* TIMER_H_ */
@@ -0,0 +1,85 @@
+/*
+ * $Id$
+ *
+ * ***** BEGIN BSD LICENSE BLOCK *****
+ *
+ * Copyright (c) 2009-2011, Jiri Hnidek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ***** END BSD LICENSE BLOCK *****
+ *
+ * Authors: Jiri Hnidek <jiri.hnidek@tul.cz>
+ *
+ */
+
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include <pthread.h>
+
+#include "types.h"
+
+#define DEFAULT_WORKER_COUNT	1
+
+/**
+ * Function executed by each worker. It gets index of worker and number of
+ * all workers, so it can pick its own part of the job.
+ */
+typedef void (*WorkerPoolFunc)(void *arg,
+		const uint16 worker_id,
+		const uint16 worker_count);
+
+/**
+ * This structure contains information about one worker thread
+ */
+typedef struct Worker {
+	pthread_t				thread;
+	uint16					id;
+	struct WorkerPool		*pool;
+} Worker;
+
+/**
+ * Pool of worker threads executing the same job in parallel. When pool has
+ * only one worker, then job is executed in the thread calling
+ * worker_pool_run() and no thread is created.
+ */
+typedef struct WorkerPool {
+	pthread_mutex_t			mutex;
+	pthread_cond_t			work_cond;		/* Signaled, when new job is ready */
+	pthread_cond_t			done_cond;		/* Signaled, when last worker finished job */
+	uint32					job_id;			/* Incremented for every new job */
+	uint16					busy_count;		/* Number of workers working on current job */
+	uint16					worker_count;	/* Number of workers in this pool */
+	uint8					run;			/* Are workers running? */
+	WorkerPoolFunc			func;
+	void					*arg;
+	struct Worker			*workers;		/* Array of worker threads */
+} WorkerPool;
+
+struct WorkerPool *create_worker_pool(uint16 worker_count);
+void worker_pool_run(struct WorkerPool *pool, WorkerPoolFunc func, void *arg);
+void free_worker_pool(struct WorkerPool *pool);
+
+#endif /* WORKER_POOL_H_ */
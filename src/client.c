@@ -37,6 +37,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <string.h>
 #include <pthread.h>
 
@@ -50,6 +51,9 @@
 #include "lu_table.h"
 #include "timer.h"
 #include "sender.h"
+#include "worker_pool.h"
+#include "receiver_stats.h"
+#include "thread_sched.h"
 
 
 /**
@@ -57,6 +61,27 @@
  */
 static void clean_client_ctx(struct Client_CTX *ctx)
 {
+	if(ctx->sessions != NULL) {
+		struct Client_CTX *session;
+		int i;
+
+		for(i=0; i<ctx->session_count; i++) {
+			session = &ctx->sessions[i];
+			/* Data shared with client context are freed later */
+			session->pd = NULL;
+			session->verse.server_name = NULL;
+			session->verse.username = NULL;
+			session->verse.password = NULL;
+			clean_client_ctx(session);
+		}
+
+		free(ctx->sessions);
+		ctx->sessions = NULL;
+	}
+
+	/* Free unused received particle data */
+	free_received_particle_data_pool(ctx);
+
 	if(ctx->pd != NULL) {
 		/* Free reference particle data */
 		free_ref_particle_data(ctx->pd);
@@ -89,10 +114,30 @@ static void clean_client_ctx(struct Client_CTX *ctx)
 		ctx->verse.password = NULL;
 	}
 
-	if(ctx->sender != NULL && ctx->sender->timer != NULL) {
-		pthread_mutex_destroy(&ctx->sender->timer->mutex);
-		free(ctx->sender->timer);
-		ctx->sender->timer = NULL;
+	if(ctx->stats_file != NULL) {
+		free(ctx->stats_file);
+		ctx->stats_file = NULL;
+	}
+
+	if(ctx->timer_cpus != NULL) {
+		free(ctx->timer_cpus);
+		ctx->timer_cpus = NULL;
+	}
+
+	if(ctx->network_cpus != NULL) {
+		free(ctx->network_cpus);
+		ctx->network_cpus = NULL;
+	}
+
+	if(ctx->main_cpus != NULL) {
+		free(ctx->main_cpus);
+		ctx->main_cpus = NULL;
+	}
+
+	if(ctx->worker_pool != NULL) {
+		free_worker_pool(ctx->worker_pool);
+		free(ctx->worker_pool);
+		ctx->worker_pool = NULL;
 	}
 
 	if(ctx->senders.first != NULL) {
@@ -105,6 +150,15 @@ static void clean_client_ctx(struct Client_CTX *ctx)
 				free(sender->rec_pd);
 				sender->rec_pd = NULL;
 			}
+			if(sender->display_particles != NULL) {
+				free(sender->display_particles);
+				sender->display_particles = NULL;
+			}
+			if(sender->timer != NULL) {
+				pthread_mutex_destroy(&sender->timer->mutex);
+				free(sender->timer);
+				sender->timer = NULL;
+			}
 			sender = sender->next;
 		}
 
@@ -123,10 +177,20 @@ static void init_client_ctx(struct Client_CTX *ctx)
 	ctx->flags = 0;
 	ctx->senders.first = ctx->senders.last = NULL;
 	ctx->sender_count = DEFAULT_SENDER_COUNT;
+	ctx->worker_count = DEFAULT_WORKER_COUNT;
+	ctx->worker_pool = NULL;
+	ctx->pump_interval = DEFAULT_PUMP_INTERVAL;
+	ctx->pump_thread = 0;
 	ctx->client_type = CLIENT_NONE;
 	ctx->pd = NULL;
+#ifdef WITH_DISPLAY
 	ctx->display = create_particle_display();
+#else
+	ctx->display = NULL;
+	ctx->flags |= VC_HEADLESS;
+#endif
 	ctx->verse.fps = DEFAULT_FPS;
+	ctx->time_scale = 1.0;
 	ctx->verse.particle_scene_node = NULL;
 	ctx->verse.server_name = NULL;
 	ctx->verse.session_id = -1;
@@ -135,8 +199,81 @@ static void init_client_ctx(struct Client_CTX *ctx)
 	ctx->verse.password = NULL;
 	ctx->receiver_thread = 0;
 	ctx->timer_thread = 0;
+	ctx->ingest_thread = 0;
+	ctx->stats_thread = 0;
+	ctx->stats_file = NULL;
+	ctx->jitter_depth = 0;
+	ctx->jitter_adaptive = 0;
+	ctx->predict_frames = 0;
+	ctx->smoothing = 1.0;
 	ctx->sender = NULL;
-	sem_init(&ctx->timer_sem, 0, 0);
+	ctx->sessions = NULL;
+	ctx->session_count = DEFAULT_SESSION_COUNT;
+	ctx->timer_offset = 0;
+	ctx->rec_pd_pool = NULL;
+	ctx->interest_radius = 0.0;
+	ctx->interest_frustum = 0;
+	ctx->timer_cpus = NULL;
+	ctx->network_cpus = NULL;
+	ctx->main_cpus = NULL;
+	ctx->rt_priority = 0;
+	ctx->verse.connected = 0;
+	ctx->verse.auth_attempts = 0;
+	sem_init(&ctx->frame_sem, 0, 0);
+	sem_init(&ctx->ingest_sem, 0, 0);
+}
+
+
+/**
+ * \brief Create contexts of Verse sessions used by load generator. All
+ * sessions share reference particle data and settings of client context.
+ */
+static int create_client_sessions(struct Client_CTX *ctx)
+{
+	struct Client_CTX *session;
+	int i;
+
+	ctx->sessions = (struct Client_CTX*)calloc(ctx->session_count, sizeof(struct Client_CTX));
+
+	if(ctx->sessions == NULL) {
+		return 0;
+	}
+
+	for(i=0; i<ctx->session_count; i++) {
+		session = &ctx->sessions[i];
+
+		session->flags = ctx->flags;
+		session->client_type = ctx->client_type;
+		/* Server name, username and password are shared */
+		session->verse = ctx->verse;
+		session->verse.session_id = -1;
+		session->verse.connected = 0;
+		session->verse.auth_attempts = 0;
+		session->verse.particle_scene_node = NULL;
+		session->verse.lu_table = lu_table_create(10000);
+		session->pd = ctx->pd;
+		session->display = NULL;
+		session->senders.first = session->senders.last = NULL;
+		session->sender = NULL;
+		session->sender_count = ctx->sender_count;
+		session->worker_count = 1;
+		session->worker_pool = NULL;
+		session->sessions = NULL;
+		session->session_count = 1;
+		session->rec_pd_pool = NULL;
+		/* Settings of received data are shared */
+		session->jitter_depth = ctx->jitter_depth;
+		session->jitter_adaptive = ctx->jitter_adaptive;
+		session->predict_frames = ctx->predict_frames;
+		/* Spread start of animation in sessions over whole animation */
+		if(ctx->client_type == CLIENT_SENDER) {
+			session->timer_offset = (i * (ctx->pd->frame_count - 1)) / ctx->session_count;
+		}
+
+		create_senders(session);
+	}
+
+	return 1;
 }
 
 
@@ -168,7 +305,9 @@ static int set_visual_type(struct Client_CTX *ctx, char *v_type)
 {
 	int ret = 0;
 
-	if(strcmp(v_type, "lines")==0) {
+	if(ctx->display == NULL) {
+		printf("ERROR: Client was built without display\n");
+	} else if(strcmp(v_type, "lines")==0) {
 		ctx->display->visual_type = VISUAL_LINE;
 		ret = 1;
 	} else if(strcmp(v_type, "dots")==0) {
@@ -230,17 +369,73 @@ static void print_help(char *prog_name)
 	printf("   -d debug_level   use debug level [none|info|error|warning|debug]\n");
 	printf("                      (default: debug)\n");
 	printf("   -f fps           use defined FPS value (default value is 25)\n");
+	printf("   -n sender_count  number of particle senders (default value is 1)\n");
+	printf("   -w worker_count  number of threads sending particles of senders\n");
+	printf("                      (receiver: threads applying received particles)\n");
+	printf("                      (default value is 1)\n");
+	printf("   -i interval      interval of callback pumping in microseconds,\n");
+	printf("                      0 pumps callbacks once per frame (default 1000)\n");
+	printf("   -l session_count load generator: number of Verse sessions\n");
+	printf("                      of sender or headless receiver\n");
+	printf("                      (default value is 1, max 255)\n");
 	printf("   -h               display this help and exit\n");
 	printf("   -s               secure UDP connection with DTLS protocol\n");
 	printf("   -c               make screen-cast to TGA files\n");
 	printf("   -u username      username used for authentication\n");
 	printf("   -p password      password used for authentication\n");
+	printf("   --headless       receiver without display printing statistics\n");
+	printf("                      of received particles\n");
+	printf("   --stats-file file export histograms of received particles\n");
+	printf("                      to JSON (CSV, when file ends with .csv)\n");
+	printf("   --jitter-buffer depth  receiver holds received states in jitter\n");
+	printf("                      buffer for depth frames (default 0: none)\n");
+	printf("   --jitter-adaptive adapt depth of jitter buffer to estimated\n");
+	printf("                      jitter, depth is the maximal depth\n");
+	printf("   --predict frames interpolate/extrapolate lost positions from\n");
+	printf("                      states received in this number of frames\n");
+	printf("                      and report error of prediction (default 0)\n");
+	printf("   --smoothing factor smoothing of displayed predicted positions,\n");
+	printf("                      1.0 disables smoothing (default 1.0)\n");
+	printf("   --interest-radius radius  receive only particles of senders\n");
+	printf("                      closer to camera than radius (default 0: all)\n");
+	printf("   --interest-frustum receive only particles of senders in view\n");
+	printf("                      frustum of camera\n");
+	printf("   --time-scale factor multiply frame rate of timer, receiver has\n");
+	printf("                      to use the same factor (default 1.0)\n");
+	printf("   --virtual-clock  sender sends next frame as soon as previous\n");
+	printf("                      frame was sent (benchmark of maximal FPS)\n");
+	printf("   --cpu-timer cpus pin timer thread to list of CPUs (e.g. 0,2-3)\n");
+	printf("   --cpu-network cpus pin threads sending/receiving data to CPUs\n");
+	printf("   --cpu-main cpus  pin display or statistics thread of receiver\n");
+	printf("   --rt-priority priority  run timer thread with SCHED_FIFO\n");
+	printf("                      priority (1-99) and network threads with\n");
+	printf("                      lower priority (default: no real-time)\n");
+	printf("   --wakeup-latency record latency of wake-up of threads driven\n");
+	printf("                      by timer\n");
 	printf("\n");
 }
 
 
 int main(int argc, char *argv[])
 {
+	static struct option long_options[] = {
+		{"headless", no_argument, NULL, 'H'},
+		{"stats-file", required_argument, NULL, 'S'},
+		{"jitter-buffer", required_argument, NULL, 'J'},
+		{"jitter-adaptive", no_argument, NULL, 'A'},
+		{"predict", required_argument, NULL, 'P'},
+		{"smoothing", required_argument, NULL, 'M'},
+		{"interest-radius", required_argument, NULL, 'R'},
+		{"interest-frustum", no_argument, NULL, 'F'},
+		{"time-scale", required_argument, NULL, 'T'},
+		{"virtual-clock", no_argument, NULL, 'V'},
+		{"cpu-timer", required_argument, NULL, 'K'},
+		{"cpu-network", required_argument, NULL, 'N'},
+		{"cpu-main", required_argument, NULL, 'G'},
+		{"rt-priority", required_argument, NULL, 'Q'},
+		{"wakeup-latency", no_argument, NULL, 'W'},
+		{NULL, 0, NULL, 0}
+	};
 	struct Client_CTX ctx;
 	int opt, ret;
 
@@ -249,8 +444,91 @@ int main(int argc, char *argv[])
 	/* When client was started with some arguments */
 	if(argc > 1) {
 		/* Parse all options */
-		while( (opt = getopt(argc, argv, "shcv:d:t:f:n:u:p:")) != -1) {
+		while( (opt = getopt_long(argc, argv, "shcv:d:t:f:n:w:i:l:u:p:",
+				long_options, NULL)) != -1) {
 			switch(opt) {
+				case 'H':
+					ctx.flags |= VC_HEADLESS;
+					break;
+				case 'S':
+					ctx.stats_file = strdup(optarg);
+					break;
+				case 'J':
+					if(sscanf(optarg, "%hhu", &ctx.jitter_depth) != 1 ||
+							ctx.jitter_depth > MAX_JITTER_DEPTH) {
+						printf("ERROR: Depth of jitter buffer has to be 0-%d frames\n",
+								MAX_JITTER_DEPTH);
+						clean_client_ctx(&ctx);
+						exit(EXIT_FAILURE);
+					}
+					break;
+				case 'A':
+					ctx.jitter_adaptive = 1;
+					break;
+				case 'P':
+					if(sscanf(optarg, "%hu", &ctx.predict_frames) != 1) {
+						ctx.predict_frames = 0;
+					}
+					break;
+				case 'M':
+					if(sscanf(optarg, "%f", &ctx.smoothing) != 1 ||
+							ctx.smoothing <= 0.0 || ctx.smoothing > 1.0) {
+						printf("ERROR: Smoothing factor has to be in range (0.0, 1.0>\n");
+						clean_client_ctx(&ctx);
+						exit(EXIT_FAILURE);
+					}
+					break;
+				case 'R':
+					if(sscanf(optarg, "%f", &ctx.interest_radius) != 1 ||
+							ctx.interest_radius < 0.0) {
+						printf("ERROR: Radius of interest has to be positive\n");
+						clean_client_ctx(&ctx);
+						exit(EXIT_FAILURE);
+					}
+					break;
+				case 'F':
+					ctx.interest_frustum = 1;
+					break;
+				case 'T':
+					if(sscanf(optarg, "%f", &ctx.time_scale) != 1 ||
+							ctx.time_scale <= 0.0) {
+						printf("ERROR: Time scale has to be positive\n");
+						clean_client_ctx(&ctx);
+						exit(EXIT_FAILURE);
+					}
+					break;
+				case 'V':
+					ctx.flags |= VC_VIRTUAL_CLOCK;
+					break;
+				case 'K':
+				case 'N':
+				case 'G':
+					if(thread_sched_check_cpus(optarg) != 1) {
+						printf("ERROR: Bad list of CPUs: %s\n", optarg);
+						clean_client_ctx(&ctx);
+						exit(EXIT_FAILURE);
+					}
+					if(opt == 'K') {
+						ctx.timer_cpus = strdup(optarg);
+					} else if(opt == 'N') {
+						ctx.network_cpus = strdup(optarg);
+					} else {
+						ctx.main_cpus = strdup(optarg);
+					}
+					break;
+				case 'Q':
+					if(sscanf(optarg, "%hhu", &ctx.rt_priority) != 1 ||
+							ctx.rt_priority < MIN_RT_PRIORITY ||
+							ctx.rt_priority > MAX_RT_PRIORITY) {
+						printf("ERROR: Real-time priority has to be %d-%d\n",
+								MIN_RT_PRIORITY, MAX_RT_PRIORITY);
+						clean_client_ctx(&ctx);
+						exit(EXIT_FAILURE);
+					}
+					break;
+				case 'W':
+					ctx.flags |= VC_WAKEUP_LATENCY;
+					break;
 				case 's':
 					ctx.flags |= VC_DGRAM_SEC_DTLS;
 					break;
@@ -286,6 +564,30 @@ int main(int argc, char *argv[])
 						ctx.verse.fps = DEFAULT_FPS;
 					}
 					break;
+				case 'n':
+					if(sscanf(optarg, "%u", &ctx.sender_count) != 1 ||
+							ctx.sender_count < 1) {
+						ctx.sender_count = DEFAULT_SENDER_COUNT;
+					}
+					break;
+				case 'w':
+					if(sscanf(optarg, "%hu", &ctx.worker_count) != 1 ||
+							ctx.worker_count < 1) {
+						ctx.worker_count = DEFAULT_WORKER_COUNT;
+					}
+					break;
+				case 'i':
+					if(sscanf(optarg, "%u", &ctx.pump_interval) != 1) {
+						ctx.pump_interval = DEFAULT_PUMP_INTERVAL;
+					}
+					break;
+				case 'l':
+					if(sscanf(optarg, "%hu", &ctx.session_count) != 1 ||
+							ctx.session_count < 1 ||
+							ctx.session_count > MAX_SESSION_COUNT) {
+						ctx.session_count = DEFAULT_SESSION_COUNT;
+					}
+					break;
 				case 'u':
 					ctx.verse.username = strdup(optarg);
 					break;
@@ -327,6 +629,21 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	if(ctx.session_count > 1 && ctx.client_type != CLIENT_SENDER &&
+			!(ctx.client_type == CLIENT_RECEIVER && (ctx.flags & VC_HEADLESS))) {
+		printf("ERROR: More Verse sessions are supported only by sender and headless receiver\n");
+		print_help(argv[0]);
+		clean_client_ctx(&ctx);
+		return EXIT_FAILURE;
+	}
+
+	if((ctx.flags & VC_VIRTUAL_CLOCK) && ctx.client_type != CLIENT_SENDER) {
+		printf("ERROR: Virtual clock is supported only by sender\n");
+		print_help(argv[0]);
+		clean_client_ctx(&ctx);
+		return EXIT_FAILURE;
+	}
+
 	/* Set up server name */
 	ctx.verse.server_name = strdup(argv[optind]);
 
@@ -334,8 +651,16 @@ int main(int argc, char *argv[])
 	 * read reference data after negotiation with server */
 	ctx.pd = read_ref_particle_data(argv[optind+1]);
 
-	/* Create linked list of senders */
-	create_senders(&ctx);
+	if(ctx.session_count > 1) {
+		/* Create Verse sessions of load generator with their own senders */
+		if(ctx.pd == NULL || create_client_sessions(&ctx) != 1) {
+			clean_client_ctx(&ctx);
+			return EXIT_FAILURE;
+		}
+	} else {
+		/* Create linked list of senders */
+		create_senders(&ctx);
+	}
 
 	/* Set up node lookup table */
 	ctx.verse.lu_table = lu_table_create(10000);	/* TODO: it has to be 10^n and less then max number of particles */
@@ -345,7 +670,10 @@ int main(int argc, char *argv[])
 		case CLIENT_NONE:
 			return EXIT_FAILURE;
 		case CLIENT_SENDER:
-			if( pthread_create(&ctx.timer_thread, NULL, timer_loop, (void*)&ctx) == 0) {
+			/* Create pool of threads sending particles */
+			ctx.worker_pool = create_worker_pool(ctx.worker_count);
+			if(ctx.worker_pool != NULL &&
+					pthread_create(&ctx.timer_thread, NULL, timer_loop, (void*)&ctx) == 0) {
 				particle_sender_loop(&ctx);
 			} else {
 				clean_client_ctx(&ctx);
@@ -353,12 +681,27 @@ int main(int argc, char *argv[])
 			}
 			break;
 		case CLIENT_RECEIVER:
-			if( pthread_create(&ctx.timer_thread, NULL, timer_loop, (void*)&ctx) != 0) {
+			/* Create pool of threads applying received particles */
+			ctx.worker_pool = create_worker_pool(ctx.worker_count);
+			if(ctx.worker_pool == NULL ||
+					pthread_create(&ctx.timer_thread, NULL, timer_loop, (void*)&ctx) != 0) {
 				clean_client_ctx(&ctx);
 				return EXIT_FAILURE;
 			} else {
 				if( pthread_create(&ctx.receiver_thread, NULL, particle_receiver_loop, (void*)&ctx) == 0) {
-					particle_display_loop(&ctx, argc, argv);
+					/* Pin display or statistics running in this thread */
+					thread_sched_setup("main", ctx.main_cpus, 0);
+					if(ctx.flags & VC_HEADLESS) {
+						receiver_stats_loop(&ctx);
+					} else {
+#ifdef WITH_DISPLAY
+						/* Print and export statistics in separate thread */
+						if(pthread_create(&ctx.stats_thread, NULL, receiver_stats_loop, (void*)&ctx) != 0) {
+							printf("ERROR: unable to create thread exporting statistics\n");
+						}
+						particle_display_loop(&ctx, argc, argv);
+#endif
+					}
 				} else {
 					clean_client_ctx(&ctx);
 					return EXIT_FAILURE;
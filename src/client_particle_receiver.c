@@ -47,18 +47,38 @@
 #include "node.h"
 #include "client.h"
 #include "lu_table.h"
+#include "timer.h"
+#include "ingest.h"
+#include "interest.h"
+#include "clock_sync.h"
+#include "thread_sched.h"
 
-static struct Client_CTX *ctx = NULL;
+static struct Client_CTX *main_ctx = NULL;
+
+/* Lookup table of client contexts indexed by ID of Verse session */
+static struct Client_CTX *session_ctx[MAX_SESSION_COUNT+1];
+
+/* Number of terminated Verse sessions */
+static uint16 terminated_count = 0;
+
+/* Ticks of timer marking frame boundaries */
+static struct TickConsumer receive_ticks;
 
 #define NO_DEBUG_PRINT 1
 
 static void handle_signal(int sig)
 {
 	if(sig == SIGINT) {
-		if(ctx != NULL) {
-			printf("%s() try to terminate connection: %d\n",
-					__FUNCTION__, ctx->verse.session_id);
-			vrs_send_connect_terminate(ctx->verse.session_id);
+		if(main_ctx != NULL) {
+			struct Client_CTX *ctx;
+			int i;
+
+			for(i=0; i<main_ctx->session_count; i++) {
+				ctx = CLIENT_SESSION(main_ctx, i);
+				printf("%s() try to terminate connection: %d\n",
+						__FUNCTION__, ctx->verse.session_id);
+				vrs_send_connect_terminate(ctx->verse.session_id);
+			}
 		} else {
 			exit(EXIT_FAILURE);
 		}
@@ -72,6 +92,7 @@ static void cb_receive_layer_unset_value(const uint8_t session_id,
 		const uint16_t layer_id,
 		const uint32_t item_id)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
 	struct Node *node;
 	struct ParticleSenderNode *sender_node;
 	struct Particle_Sender *sender;
@@ -87,20 +108,16 @@ static void cb_receive_layer_unset_value(const uint8_t session_id,
 
 	if(node != NULL &&
 			node->type == PARTICLE_SENDER_NODE) {
-		struct ReceivedParticle *rec_particle;
+		struct IngestRecord record;
 		sender_node = (struct ParticleSenderNode*)node;
 		sender = sender_node->sender;
 
 		if(layer_id == sender_node->particle_layer_id) {
-
-			pthread_mutex_lock(&sender_node->sender->rec_pd->mutex);
-
-			rec_particle = &sender->rec_pd->received_particles[item_id];
-			rec_particle->first_received_state = NULL;
-			rec_particle->last_received_state = NULL;
-			rec_particle->current_received_state = NULL;
-
-			pthread_mutex_unlock(&sender_node->sender->rec_pd->mutex);
+			record.type = INGEST_UNSET_VALUE;
+			record.item_id = item_id;
+			record.frame = 0;
+			record.time = 0;
+			ingest_push(sender->rec_pd, &record);
 		}
 
 	} else {
@@ -108,6 +125,36 @@ static void cb_receive_layer_unset_value(const uint8_t session_id,
 	}
 }
 
+static void _sync_marker_received(struct ParticleSenderNode *sender_node,
+		const real32 *value)
+{
+	struct IngestRecord record;
+
+	sender_node->layer_sync = LAYER_SYNC_LIVE;
+
+	/* Start timer at frame of snapshot, when no frame tag was received yet,
+	 * so statistics are valid after one round trip */
+	timer_start(sender_node->sender->timer, (int16)value[0]);
+
+	/* Ingest thread seeds received data with states of this frame */
+	record.type = INGEST_SYNC_MARK;
+	record.item_id = 0;
+	record.frame = (int16)value[0];
+	record.loop = (uint16)value[1];
+	record.time = timer_get_usec();
+	ingest_push(sender_node->sender->rec_pd, &record);
+}
+
+static void _time_response_received(struct ParticleSenderNode *sender_node,
+		const uint64 *value)
+{
+	uint64 now = timer_get_usec();
+
+	if(sender_node->sender->rec_pd != NULL) {
+		clock_sync_response(&sender_node->sender->rec_pd->clock, value, now);
+	}
+}
+
 static void cb_receive_layer_set_value(const uint8_t session_id,
 		const uint32_t node_id,
 		const uint16_t layer_id,
@@ -116,20 +163,18 @@ static void cb_receive_layer_set_value(const uint8_t session_id,
 		const uint8_t count,
 		const void *value)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
 	struct Node *node;
 	struct ParticleSenderNode *sender_node;
 	struct Particle_Sender *sender;
-	struct RefParticleState *ref_state;
-	uint16 current_frame;
+	struct IngestRecord record;
+	struct TimerSnapshot timer;
 
 #if NO_DEBUG_PRINT != 1
 	printf("%s() session_id: %u, node_id: %u, layer_id: %u, item_id: %u, data_type: %u, count: %u, value: %p\n",
 				__FUNCTION__, session_id, node_id, layer_id, item_id, data_type, count, value);
 #else
 	(void)session_id;
-	(void)layer_id;
-	(void)data_type;
-	(void)count;
 #endif
 
 	node = lu_find(ctx->verse.lu_table, node_id);
@@ -138,61 +183,48 @@ static void cb_receive_layer_set_value(const uint8_t session_id,
 		sender_node = (struct ParticleSenderNode*)node;
 		sender = sender_node->sender;
 
-		pthread_mutex_lock(&sender_node->sender->timer->mutex);
-		current_frame = sender_node->sender->timer->frame;
-		pthread_mutex_unlock(&sender_node->sender->timer->mutex);
-
-		pthread_mutex_lock(&sender_node->sender->rec_pd->mutex);
-
-		/* Find reference state */
-		ref_state = find_ref_particle_state(ctx->pd,
-				&ctx->pd->particles[item_id],
-				sender_node->sender->rec_pd->rec_frame,
-				(real32*)value);
-
-		/* Was reference state found? */
-		if(ref_state != NULL) {
-			struct ReceivedParticleState *rec_state;
-			struct ReceivedParticle *rec_particle;
-
-			rec_state = &sender->rec_pd->received_particles[item_id].received_states[ref_state->frame];
-			rec_particle = &sender->rec_pd->received_particles[item_id];
-
-			/* Set up first, last and current received state */
-			if(rec_particle->first_received_state == NULL) {
-				rec_particle->first_received_state = rec_state;
-				rec_particle->last_received_state = rec_state;
-			} else {
-				if(rec_particle->first_received_state->ref_particle_state->frame > rec_state->ref_particle_state->frame) {
-					rec_particle->first_received_state = rec_state;
-				}
-				if(rec_particle->last_received_state->ref_particle_state->frame < rec_state->ref_particle_state->frame) {
-					rec_particle->last_received_state = rec_state;
-				}
+		/* Response of sender to time request of this receiver */
+		if(layer_id == sender_node->time_resp_layer_id) {
+			if(item_id == ctx->verse.avatar_id &&
+					data_type == VRS_VALUE_TYPE_UINT64 && count == 3) {
+				_time_response_received(sender_node, (uint64*)value);
 			}
+			return;
+		}
 
-			/* This state is the current received */
-			rec_particle->current_received_state = rec_state;
-
-			/* At this frame was particle received */
-			rec_state->received_frame = current_frame;
-			/* Set up delay of receiving */
-			rec_state->delay = current_frame - ref_state->frame;
+		if(layer_id != sender_node->particle_layer_id) {
+			return;
+		}
 
-			/* Set up state according delay */
-			if(rec_state->delay == 0 || rec_state->delay == 1) {
-				rec_state->state = RECEIVED_STATE_INTIME;
-			} else if( rec_state->delay > 1) {
-				rec_state->state = RECEIVED_STATE_DELAY;
-			} else {
-				rec_state->state = RECEIVED_STATE_AHEAD;
+		/* Marker with frame and loop of layer content. Snapshot of layer
+		 * could end with marker of the current frame. */
+		if(item_id == SYNC_MARKER_ITEM) {
+			if(sender_node->layer_sync == LAYER_SYNC_WAIT ||
+					sender_node->layer_sync == LAYER_SYNC_SNAPSHOT) {
+				_sync_marker_received(sender_node, (real32*)value);
 			}
+			return;
+		}
 
-		} else {
-			printf("ERROR: Reference particle state not found\n");
+		timer_read(sender->timer, &timer);
+
+		/* Server sends whole content of layer after subscription in any
+		 * order. Values received before marker are held by ingest thread
+		 * until frame of snapshot is known. */
+		if(sender_node->layer_sync == LAYER_SYNC_WAIT) {
+			sender_node->layer_sync = LAYER_SYNC_SNAPSHOT;
 		}
 
-		pthread_mutex_unlock(&sender_node->sender->rec_pd->mutex);
+		/* Matching with reference data is done by ingest thread */
+		record.type = (sender_node->layer_sync == LAYER_SYNC_SNAPSHOT) ?
+				INGEST_SYNC_VALUE : INGEST_SET_VALUE;
+		record.item_id = item_id;
+		record.frame = timer.frame;
+		record.pos[0] = ((real32*)value)[0];
+		record.pos[1] = ((real32*)value)[1];
+		record.pos[2] = ((real32*)value)[2];
+		record.time = timer_get_usec();
+		ingest_push(sender->rec_pd, &record);
 
 	} else {
 		printf("ERROR: Sender node not found\n");
@@ -207,6 +239,7 @@ static void cb_receive_layer_create(const uint8 session_id,
 		const uint8 count,
 		const uint16 custom_type)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
 	struct Node *node;
 	struct ParticleSenderNode *sender_node;
 
@@ -214,6 +247,7 @@ static void cb_receive_layer_create(const uint8 session_id,
 	printf("%s() session_id: %u, node_id: %u, layer_id: %u, parent_layer_id: %u, data_type: %u, count: %u, custom_type: %u\n",
 				__FUNCTION__, session_id, node_id, layer_id, parent_layer_id, data_type, count, custom_type);
 #else
+	(void)session_id;
 	(void)parent_layer_id;
 	(void)data_type;
 	(void)count;
@@ -222,10 +256,18 @@ static void cb_receive_layer_create(const uint8 session_id,
 	node = lu_find(ctx->verse.lu_table, node_id);
 
 	if(node->type == PARTICLE_SENDER_NODE) {
+		sender_node = (struct ParticleSenderNode*)node;
 		if(custom_type == PARTICLE_POS_LAYER) {
-			sender_node = (struct ParticleSenderNode*)node;
 			sender_node->particle_layer_id = layer_id;
 
+			/* Layer of sender out of interest is subscribed later */
+			interest_subscribe_sender(ctx, sender_node);
+		} else if(custom_type == TIME_REQUEST_LAYER) {
+			sender_node->time_req_layer_id = layer_id;
+		} else if(custom_type == TIME_RESPONSE_LAYER) {
+			/* Responses to all receivers are received, only item of this
+			 * receiver is used */
+			sender_node->time_resp_layer_id = layer_id;
 			vrs_send_layer_subscribe(session_id, VRS_DEFAULT_PRIORITY,
 					node_id, layer_id, 0, 0);
 		}
@@ -233,20 +275,50 @@ static void cb_receive_layer_create(const uint8 session_id,
 }
 
 static void _frame_received(struct ParticleSenderNode *sender_node,
-		int16 value)
+		const uint16 *value)
 {
-	/* Start timer, when first frame value is received */
-	pthread_mutex_lock(&sender_node->sender->timer->mutex);
-	if(sender_node->sender->timer->run == 0) {
-		sender_node->sender->timer->run = 1;
-		sender_node->sender->timer->tot_frame = value;
+	struct IngestRecord record;
+	struct TimerSnapshot timer;
+
+	/* Start timer at frame and time of first received frame tag */
+	timer_read(sender_node->sender->timer, &timer);
+	if(timer.run == 0) {
+		timer_start(sender_node->sender->timer, (int16)value[0]);
 	}
-	pthread_mutex_unlock(&sender_node->sender->timer->mutex);
 
-	/* Save received frame */
-	pthread_mutex_lock(&sender_node->sender->rec_pd->mutex);
-	sender_node->sender->rec_pd->rec_frame = value;
-	pthread_mutex_unlock(&sender_node->sender->rec_pd->mutex);
+	/* Save received frame and its loop */
+	record.type = INGEST_FRAME;
+	record.item_id = 0;
+	record.frame = (int16)value[0];
+	record.loop = value[1];
+	record.time = 0;
+	ingest_push(sender_node->sender->rec_pd, &record);
+}
+
+static void _loop_received(struct ParticleSenderNode *sender_node,
+		uint16 value)
+{
+	struct IngestRecord record;
+
+	/* Received data are reset by ingest thread in new loop of animation */
+	record.type = INGEST_LOOP;
+	record.item_id = 0;
+	record.frame = (int16)value;
+	record.time = 0;
+	ingest_push(sender_node->sender->rec_pd, &record);
+}
+
+static void _frame_time_received(struct ParticleSenderNode *sender_node,
+		const uint64 *value)
+{
+	struct IngestRecord record;
+
+	/* Time of sending frame is used for measuring of one-way delay */
+	record.type = INGEST_FRAME_TIME;
+	record.item_id = 0;
+	record.frame = (int16)value[0];
+	record.time = value[1];
+	ingest_push(sender_node->sender->rec_pd, &record);
 }
 
 static void cb_receive_tag_set_value(const uint8 session_id,
@@ -257,6 +329,7 @@ static void cb_receive_tag_set_value(const uint8 session_id,
 		const uint8_t count,
 		const void *value)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
 	struct Node *node;
 	/* struct ParticleSceneNode *scene_node; */
 	/* struct ParticleNode *particle_node; */
@@ -285,8 +358,14 @@ static void cb_receive_tag_set_value(const uint8 session_id,
 
 			/* Was current frame received? */
 			if(sender_node->particle_taggroup_id == taggroup_id) {
-				if(sender_node->particle_frame_tag_id == tag_id) {
-					_frame_received(sender_node, *(int16*)value);
+				if(sender_node->particle_frame_tag_id == tag_id &&
+						data_type == VRS_VALUE_TYPE_UINT16 && count == 2) {
+					_frame_received(sender_node, (uint16*)value);
+				} else if(sender_node->loop_tag_id == tag_id) {
+					_loop_received(sender_node, *(uint16*)value);
+				} else if(sender_node->frame_time_tag_id == tag_id &&
+						data_type == VRS_VALUE_TYPE_UINT64 && count == 2) {
+					_frame_time_received(sender_node, (uint64*)value);
 				}
 			}
 			break;
@@ -320,6 +399,7 @@ static void cb_receive_tag_create(const uint8 session_id,
 		const uint8 count,
 		const uint16 custom_type)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
 	struct Node *node;
 	struct ParticleSceneNode *scene_node;
 	struct ParticleSenderNode *sender_node;
@@ -353,6 +433,7 @@ static void cb_receive_tag_create(const uint8 session_id,
 			if(sender_node->particle_taggroup_id == taggroup_id)
 			{
 				if(data_type == VRS_VALUE_TYPE_UINT16 &&
+						count == 2 &&
 						custom_type == PARTICLE_FRAME_TAG)
 				{
 					sender_node->particle_frame_tag_id = tag_id;
@@ -373,6 +454,16 @@ static void cb_receive_tag_create(const uint8 session_id,
 				{
 					sender_node->sender_id_tag_id = tag_id;
 				}
+				else if(data_type == VRS_VALUE_TYPE_UINT16 &&
+						custom_type == PARTICLE_LOOP_TAG)
+				{
+					sender_node->loop_tag_id = tag_id;
+				}
+				else if(data_type == VRS_VALUE_TYPE_UINT64 &&
+						custom_type == FRAME_TIME_TAG)
+				{
+					sender_node->frame_time_tag_id = tag_id;
+				}
 			}
 			break;
 #if 0
@@ -419,6 +510,7 @@ static void cb_receive_taggroup_create(const uint8 session_id,
 		const uint16 taggroup_id,
 		const uint16 custom_type)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
 	struct Node *node;
 	struct ParticleSceneNode *scene_node;
 	struct ParticleSenderNode *sender_node;
@@ -467,6 +559,8 @@ static void cb_receive_node_create(const uint8 session_id,
 		const uint16 user_id,
 		const uint16 custom_type)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
+
 #if NO_DEBUG_PRINT != 1
 	printf("%s() session_id: %d, node_id: %d, parent_id: %d, user_id: %d, custom_type: %d\n",
 			__FUNCTION__, session_id, node_id, parent_id, user_id, custom_type);
@@ -511,6 +605,15 @@ static void cb_receive_node_create(const uint8 session_id,
 				printf("Info: setting up references\n");
 				sender_node->sender = sender;
 				sender->sender_node = sender_node;
+				/* New sender node is not in interest until its layer is
+				 * subscribed by update_interest() */
+				__atomic_store_n(&sender->interest,
+						(interest_is_enabled(ctx) == 0) ? 1 : 0, __ATOMIC_RELAXED);
+				/* Received data are allocated only for bound sender nodes */
+				if(sender->rec_pd == NULL) {
+					__atomic_store_n(&sender->rec_pd,
+							acquire_received_particle_data(ctx), __ATOMIC_RELEASE);
+				}
 			} else {
 				printf("Error: no remaining free sender\n");
 			}
@@ -529,14 +632,41 @@ static void cb_receive_node_create(const uint8 session_id,
 static void cb_receive_node_destroy(const uint8 session_id,
 		const uint32 node_id)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
+	struct Node *node;
+	struct ParticleSenderNode *sender_node;
+	struct Particle_Sender *sender;
+	struct ReceivedParticleData *rpd;
+
 #if NO_DEBUG_PRINT != 1
 	printf("%s() session_id: %d, node_id: %d\n",
 			__FUNCTION__, session_id, node_id);
 #else
 	(void)session_id;
-	(void)node_id;
 #endif
-	/* TODO: add some usefull code here  */
+
+	node = lu_find(ctx->verse.lu_table, node_id);
+
+	if(node == NULL || node->type != PARTICLE_SENDER_NODE) {
+		return;
+	}
+
+	sender_node = (struct ParticleSenderNode*)node;
+	sender = sender_node->sender;
+
+	/* Unbind sender and return its received data to the pool */
+	if(sender != NULL) {
+		rpd = __atomic_exchange_n(&sender->rec_pd, NULL, __ATOMIC_ACQ_REL);
+		if(rpd != NULL) {
+			release_received_particle_data(ctx, rpd);
+		}
+		timer_stop(sender->timer);
+		sender->sender_node = NULL;
+	}
+
+	lu_rem_item(ctx->verse.lu_table, node_id);
+	v_list_free(&sender_node->particles);
+	v_list_free_item(&ctx->verse.particle_scene_node->senders, sender_node);
 }
 
 static void cb_receive_node_link(const uint8 session_id,
@@ -558,6 +688,8 @@ static void cb_receive_connect_accept(const uint8 session_id,
       const uint16 user_id,
       const uint32 avatar_id)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
+
 #if NO_DEBUG_PRINT != 1
 	printf("%s() session_id: %d, user_id: %d, avatar_id: %d\n",
 			__FUNCTION__, session_id, user_id, avatar_id);
@@ -565,6 +697,7 @@ static void cb_receive_connect_accept(const uint8 session_id,
 
 	ctx->verse.avatar_id = avatar_id;
 	ctx->verse.user_id = user_id;
+	ctx->verse.connected = 1;
 
 	/* Subscribe to avatar node */
 	vrs_send_node_subscribe(session_id, VRS_DEFAULT_PRIORITY, avatar_id, 0, 0);
@@ -577,14 +710,22 @@ static void cb_receive_connect_accept(const uint8 session_id,
 static void cb_receive_connect_terminate(const uint8 session_id,
 		const uint8 error_num)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
+
 #if NO_DEBUG_PRINT != 1
 	printf("%s() session_id: %d, error_num: %d\n",
 			__FUNCTION__, session_id, error_num);
 #else
-	(void)session_id;
 	(void)error_num;
 #endif
-	exit(0);
+
+	ctx->verse.connected = 0;
+
+	/* Exit, when all sessions are terminated */
+	terminated_count++;
+	if(terminated_count >= main_ctx->session_count) {
+		exit(0);
+	}
 }
 
 static void cb_receive_user_authenticate(const uint8 session_id,
@@ -592,7 +733,7 @@ static void cb_receive_user_authenticate(const uint8 session_id,
 		const uint8 auth_methods_count,
 		const uint8 *methods)
 {
-	static int attempts=0;	/* Store number of authentication attempt for this session. */
+	struct Client_CTX *ctx = session_ctx[session_id];
 	char name[64];
 	char *password;
 	int i, is_passwd_supported=0;
@@ -612,7 +753,7 @@ static void cb_receive_user_authenticate(const uint8 session_id,
 		if(ctx->verse.username == NULL) {
 			printf("Username: ");
 			scanf("%s", name);
-			attempts = 0;	/* Reset counter of auth. attempt. */
+			ctx->verse.auth_attempts = 0;	/* Reset counter of auth. attempt. */
 			vrs_send_user_authenticate(session_id, name, VRS_UA_METHOD_NONE, NULL);
 		} else {
 			vrs_send_user_authenticate(session_id, ctx->verse.username, VRS_UA_METHOD_NONE, NULL);
@@ -621,12 +762,12 @@ static void cb_receive_user_authenticate(const uint8 session_id,
 		if(is_passwd_supported==1) {
 			strcpy(name, username);
 			/* Print this warning, when previous authentication attempt failed. */
-			if(attempts>0)
+			if(ctx->verse.auth_attempts > 0)
 				printf("Permission denied, please try again.\n");
 			if(ctx->verse.password == NULL) {
 				/* Get password from user */
 				password = getpass("Password: ");
-				attempts++;
+				ctx->verse.auth_attempts++;
 				vrs_send_user_authenticate(session_id, username, VRS_UA_METHOD_PASSWORD, password);
 			} else {
 				vrs_send_user_authenticate(session_id, username, VRS_UA_METHOD_PASSWORD, ctx->verse.password);
@@ -664,11 +805,41 @@ static void register_cb_func_particle_receiver(void)
 	vrs_register_receive_layer_unset_value(cb_receive_layer_unset_value);
 }
 
+/**
+ * \brief This function calls callback functions of all Verse sessions
+ */
+static void update_callbacks(struct Client_CTX *client_ctx)
+{
+	int i;
+
+	for(i=0; i<client_ctx->session_count; i++) {
+		vrs_callback_update(CLIENT_SESSION(client_ctx, i)->verse.session_id);
+	}
+}
+
+/**
+ * \brief This function updates interest and synchronization of clocks of all
+ * Verse sessions and it lets
+ * ingest thread apply records received till this frame tick
+ */
+static void receive_frame_tick(struct Client_CTX *client_ctx)
+{
+	int i;
+
+	for(i=0; i<client_ctx->session_count; i++) {
+		update_interest(CLIENT_SESSION(client_ctx, i));
+		update_clock_sync(CLIENT_SESSION(client_ctx, i));
+	}
+
+	sem_post(&client_ctx->ingest_sem);
+}
+
 void *particle_receiver_loop(void *arg)
 {
-	int ret;
+	struct Client_CTX *ctx;
+	int i, ret;
 
-	ctx = (struct Client_CTX*)arg;
+	main_ctx = (struct Client_CTX*)arg;
 
 	/* Handle SIGINT signal. The handle_signal function will try to terminate
 	 * connection. */
@@ -676,16 +847,48 @@ void *particle_receiver_loop(void *arg)
 
 	register_cb_func_particle_receiver();
 
-	if((ret = vrs_send_connect_request(ctx->verse.server_name, "12345",
-			VRS_SEC_DATA_NONE ,&ctx->verse.session_id))!=VRS_SUCCESS) {
-		printf("ERROR: %s\n", vrs_strerror(ret));
+	/* Connect all Verse sessions */
+	for(i=0; i<main_ctx->session_count; i++) {
+		ctx = CLIENT_SESSION(main_ctx, i);
+		if((ret = vrs_send_connect_request(ctx->verse.server_name, "12345",
+				VRS_SEC_DATA_NONE ,&ctx->verse.session_id))!=VRS_SUCCESS) {
+			printf("ERROR: %s\n", vrs_strerror(ret));
+			return 0;
+		}
+		session_ctx[ctx->verse.session_id] = ctx;
+	}
+
+	/* Received data of all sessions are applied in separate thread */
+	if(pthread_create(&main_ctx->ingest_thread, NULL, particle_ingest_loop, (void*)main_ctx) != 0) {
+		printf("ERROR: unable to create thread applying received data\n");
 		return 0;
 	}
 
+	/* Ingest thread does not inherit pinning and priority of this thread */
+	thread_sched_setup("receiver", main_ctx->network_cpus,
+			NETWORK_RT_PRIORITY(main_ctx->rt_priority));
+
+	tick_consumer_init(&receive_ticks, "receiver");
+
 	/* Never ending loop */
-	while(1) {
-		sem_wait(&ctx->timer_sem);
-		vrs_callback_update(ctx->verse.session_id);
+	if(main_ctx->pump_interval > 0) {
+		/* Call callbacks continuously and let the timer only mark frame
+		 * boundaries, when received records are applied. Delay of received
+		 * particles is not increased by waiting for next frame. */
+		while(1) {
+			update_callbacks(main_ctx);
+			/* Frame ticks missed during callback update are coalesced */
+			if(tick_consumer_poll(&receive_ticks) > 0) {
+				receive_frame_tick(main_ctx);
+			}
+			usleep(main_ctx->pump_interval);
+		}
+	} else {
+		while(1) {
+			tick_consumer_wait(&receive_ticks);
+			update_callbacks(main_ctx);
+			receive_frame_tick(main_ctx);
+		}
 	}
 
 	return NULL;
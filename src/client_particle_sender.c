@@ -39,6 +39,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
+#include <sys/time.h>
 
 #include <verse.h>
 
@@ -49,22 +50,87 @@
 #include "node.h"
 #include "client.h"
 #include "lu_table.h"
+#include "worker_pool.h"
+#include "timer.h"
+#include "spsc_ring.h"
+#include "thread_sched.h"
 
-static struct Client_CTX *ctx = NULL;
+static struct Client_CTX *main_ctx = NULL;
+
+/* Lookup table of client contexts indexed by ID of Verse session */
+static struct Client_CTX *session_ctx[MAX_SESSION_COUNT+1];
+
+/* Number of terminated Verse sessions */
+static uint16 terminated_count = 0;
+
+#define SENDER_EVENT_ATTACH	1
+
+/**
+ * Event sent from thread calling callbacks to thread sending particles
+ */
+typedef struct SenderEvent {
+	uint8						type;
+	struct Client_CTX			*ctx;		/* Context of Verse session */
+	struct Particle_Sender		*sender;
+	uint64						time;		/* Time of event creation */
+} SenderEvent;
+
+/**
+ * Sender attached to thread sending particles
+ */
+typedef struct ActiveSender {
+	struct Client_CTX			*ctx;		/* Context of Verse session */
+	struct Particle_Sender		*sender;
+} ActiveSender;
+
+/**
+ * Latency counters of one stage of sender pipeline
+ */
+typedef struct StageStats {
+	uint32						count;
+	uint64						total_usec;
+	uint64						max_usec;
+} StageStats;
+
+/* Queue of events from callbacks to sending thread */
+static struct SPSC_Ring *event_ring = NULL;
+
+/* Senders known by sending thread */
+static struct ActiveSender *active_senders = NULL;
+static uint32 active_count = 0;
+static uint32 active_max_count = 0;
+
+/* Latency of callbacks, events in queue and sending of frames */
+static struct StageStats pump_stats, queue_stats, send_stats;
+
+/* Ticks of timer driving sending of frames */
+static struct TickConsumer send_ticks;
 
 #define NO_DEBUG_PRINT 1
 
 static void handle_signal(int sig)
 {
 	if(sig == SIGINT) {
-		if(ctx != NULL) {
-			printf("%s() try to terminate connection: %d\n",
-					__FUNCTION__, ctx->verse.session_id);
-			/* Try to delete particle sender node */
-			vrs_send_node_destroy(ctx->verse.session_id, VRS_DEFAULT_PRIORITY,
-					ctx->sender->sender_node->node_id);
-			/* Terminate connection */
-			vrs_send_connect_terminate(ctx->verse.session_id);
+		if(main_ctx != NULL) {
+			struct Client_CTX *ctx;
+			struct Particle_Sender *sender;
+			int i;
+
+			for(i=0; i<main_ctx->session_count; i++) {
+				ctx = CLIENT_SESSION(main_ctx, i);
+
+				printf("%s() try to terminate connection: %d\n",
+						__FUNCTION__, ctx->verse.session_id);
+				/* Try to delete all particle sender nodes */
+				for(sender = ctx->senders.first; sender != NULL; sender = sender->next) {
+					if(sender->sender_node != NULL) {
+						vrs_send_node_destroy(ctx->verse.session_id, VRS_DEFAULT_PRIORITY,
+								sender->sender_node->node_id);
+					}
+				}
+				/* Terminate connection */
+				vrs_send_connect_terminate(ctx->verse.session_id);
+			}
 		} else {
 			exit(EXIT_FAILURE);
 		}
@@ -73,6 +139,67 @@ static void handle_signal(int sig)
 	}
 }
 
+/**
+ * \brief This function adds latency to counters of pipeline stage. It could
+ * be called concurrently with stage_stats_print().
+ */
+static void stage_stats_add(struct StageStats *stats, uint64 usec)
+{
+	__atomic_fetch_add(&stats->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats->total_usec, usec, __ATOMIC_RELAXED);
+	if(usec > __atomic_load_n(&stats->max_usec, __ATOMIC_RELAXED)) {
+		__atomic_store_n(&stats->max_usec, usec, __ATOMIC_RELAXED);
+	}
+}
+
+/**
+ * \brief This function prints and resets counters of pipeline stage
+ */
+static void stage_stats_print(const char *name, struct StageStats *stats)
+{
+	uint32 count = __atomic_exchange_n(&stats->count, 0, __ATOMIC_RELAXED);
+	uint64 total_usec = __atomic_exchange_n(&stats->total_usec, 0, __ATOMIC_RELAXED);
+	uint64 max_usec = __atomic_exchange_n(&stats->max_usec, 0, __ATOMIC_RELAXED);
+
+	printf(" %s: %u, avg: %.1f us, max: %lu us;", name, count,
+			(count > 0) ? (float)total_usec/count : 0.0,
+			(unsigned long)max_usec);
+}
+
+/**
+ * \brief This function attaches sender to the sending thread, when all IDs
+ * needed for sending are known
+ */
+static void attach_sender(struct Client_CTX *ctx,
+		struct ParticleSenderNode *sender_node)
+{
+	struct Particle_Sender *sender = sender_node->sender;
+	struct SenderEvent event;
+
+	if(sender == NULL || sender->attached == 1) {
+		return;
+	}
+
+	/* IDs are published to sending thread by the attach event */
+	if(sender_node->particle_layer_id == (uint16)-1 ||
+			sender_node->particle_frame_tag_id == (uint16)-1 ||
+			sender_node->loop_tag_id == (uint16)-1 ||
+			sender_node->frame_time_tag_id == (uint16)-1) {
+		return;
+	}
+
+	event.type = SENDER_EVENT_ATTACH;
+	event.ctx = ctx;
+	event.sender = sender;
+	event.time = timer_get_usec();
+
+	if(spsc_ring_push(event_ring, &event) == 1) {
+		sender->attached = 1;
+	} else {
+		printf("ERROR: queue of sender events is full\n");
+	}
+}
+
 static void cb_receive_layer_set_value(const uint8_t session_id,
 		const uint32_t node_id,
 		const uint16_t layer_id,
@@ -81,18 +208,38 @@ static void cb_receive_layer_set_value(const uint8_t session_id,
 		const uint8_t count,
 		const void *value)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
+	struct Node *node;
+	struct ParticleSenderNode *sender_node;
+	uint64 receive_time = timer_get_usec();
+	uint64 times[3];
+
 #if NO_DEBUG_PRINT != 1
 	printf("%s() session_id: %u, node_id: %u, layer_id: %u, item_id: %u, data_type: %u, count: %u, value: %p\n",
 				__FUNCTION__, session_id, node_id, layer_id, item_id, data_type, count, value);
-#else
-	(void)session_id;
-	(void)node_id;
-	(void)layer_id;
-	(void)item_id;
-	(void)data_type;
-	(void)count;
-	(void)value;
 #endif
+
+	node = lu_find(ctx->verse.lu_table, node_id);
+
+	if(node != NULL && node->type == PARTICLE_SENDER_NODE) {
+		sender_node = (struct ParticleSenderNode*)node;
+
+		/* Answer request of receiver estimating offset of clocks: time of
+		 * request, time of receiving and time of sending. Response is sent
+		 * to the item of the receiver (ID of its avatar). */
+		if(layer_id == sender_node->time_req_layer_id &&
+				sender_node->time_resp_layer_id != (uint16)-1 &&
+				data_type == VRS_VALUE_TYPE_UINT64 &&
+				count == 1)
+		{
+			times[0] = *(uint64*)value;
+			times[1] = receive_time;
+			times[2] = timer_get_usec();
+			vrs_send_layer_set_value(session_id, VRS_DEFAULT_PRIORITY,
+					node_id, sender_node->time_resp_layer_id, item_id,
+					VRS_VALUE_TYPE_UINT64, 3, times);
+		}
+	}
 }
 
 static void cb_receive_layer_create(const uint8 session_id,
@@ -103,6 +250,7 @@ static void cb_receive_layer_create(const uint8 session_id,
 		const uint8 count,
 		const uint16 custom_type)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
 	struct Node *node;
 	struct ParticleSenderNode *sender_node;
 
@@ -120,9 +268,17 @@ static void cb_receive_layer_create(const uint8 session_id,
 
 	/* When this is layer of particles, then remember ID of this layer */
 	if(node->type == PARTICLE_SENDER_NODE) {
+		sender_node = (struct ParticleSenderNode*)node;
 		if(custom_type == PARTICLE_POS_LAYER) {
-			sender_node = (struct ParticleSenderNode*)node;
 			sender_node->particle_layer_id = layer_id;
+			attach_sender(ctx, sender_node);
+		} else if(custom_type == TIME_REQUEST_LAYER) {
+			/* Time requests written by receivers are received */
+			sender_node->time_req_layer_id = layer_id;
+			vrs_send_layer_subscribe(session_id, VRS_DEFAULT_PRIORITY,
+					node_id, layer_id, 0, 0);
+		} else if(custom_type == TIME_RESPONSE_LAYER) {
+			sender_node->time_resp_layer_id = layer_id;
 		}
 	}
 }
@@ -135,6 +291,7 @@ static void cb_receive_tag_set_value(const uint8 session_id,
 		const uint8 count,
 		const void *value)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
 	struct Node *node;
 	struct ParticleSenderNode *sender_node;
 	/*struct ParticleSceneNode *scene_node;*/
@@ -198,6 +355,7 @@ static void cb_receive_tag_create(const uint8 session_id,
 		const uint8 count,
 		const uint16 custom_type)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
 	struct Node *node;
 	struct ParticleSceneNode *scene_node;
 	struct ParticleSenderNode *sender_node;
@@ -228,18 +386,14 @@ static void cb_receive_tag_create(const uint8 session_id,
 
 			if(sender_node->particle_taggroup_id == taggroup_id) {
 				if(data_type == VRS_VALUE_TYPE_UINT16 &&
-						count == 1 &&
+						count == 2 &&
 						custom_type == PARTICLE_FRAME_TAG)
 				{
-					/* Save ID of Tag containing Frame */
+					/* Save ID of Tag containing Frame and its loop */
 					sender_node->particle_frame_tag_id = tag_id;
 					/* Start sending of particles */
-					pthread_mutex_lock(&sender_node->sender->timer->mutex);
-					if(sender_node->sender->timer->run == 0) {
-						sender_node->sender->timer->run = 1;
-						sender_node->sender->timer->tot_frame = -25;
-					}
-					pthread_mutex_unlock(&sender_node->sender->timer->mutex);
+					timer_start(sender_node->sender->timer, ctx->timer_offset - 25);
+					attach_sender(ctx, sender_node);
 				}
 				else if(data_type == VRS_VALUE_TYPE_REAL32 &&
 						count == 3 &&
@@ -271,6 +425,20 @@ static void cb_receive_tag_create(const uint8 session_id,
 								node_id, taggroup_id, tag_id, data_type, count, &sender_node->sender->id);
 					}
 				}
+				else if(data_type == VRS_VALUE_TYPE_UINT16 && count == 1
+						&& custom_type == PARTICLE_LOOP_TAG)
+				{
+					/* Save ID of Tag containing number of animation loop */
+					sender_node->loop_tag_id = tag_id;
+					attach_sender(ctx, sender_node);
+				}
+				else if(data_type == VRS_VALUE_TYPE_UINT64 && count == 2
+						&& custom_type == FRAME_TIME_TAG)
+				{
+					/* Save ID of Tag containing time of sending frame */
+					sender_node->frame_time_tag_id = tag_id;
+					attach_sender(ctx, sender_node);
+				}
 			}
 			break;
 		}
@@ -297,6 +465,7 @@ static void cb_receive_taggroup_create(const uint8 session_id,
 		const uint16 taggroup_id,
 		const uint16 custom_type)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
 	struct Node *node;
 	struct ParticleSceneNode *scene_node;
 	struct ParticleSenderNode *sender_node;
@@ -331,13 +500,17 @@ static void cb_receive_taggroup_create(const uint8 session_id,
 				vrs_send_taggroup_subscribe(session_id, VRS_DEFAULT_PRIORITY, node_id, taggroup_id, 0, 0);
 
 				vrs_send_tag_create(session_id, VRS_DEFAULT_PRIORITY,
-						node_id, taggroup_id, VRS_VALUE_TYPE_UINT16, 1, PARTICLE_FRAME_TAG);
+						node_id, taggroup_id, VRS_VALUE_TYPE_UINT16, 2, PARTICLE_FRAME_TAG);
 				vrs_send_tag_create(session_id, VRS_DEFAULT_PRIORITY,
 						node_id, taggroup_id, VRS_VALUE_TYPE_UINT16, 1, PARTICLE_COUNT_TAG);
 				vrs_send_tag_create(session_id, VRS_DEFAULT_PRIORITY,
 						node_id, taggroup_id, VRS_VALUE_TYPE_UINT16, 1, SENDER_ID_TAG);
 				vrs_send_tag_create(session_id, VRS_DEFAULT_PRIORITY,
 						node_id, taggroup_id, VRS_VALUE_TYPE_REAL32, 3, POSITION_TAG);
+				vrs_send_tag_create(session_id, VRS_DEFAULT_PRIORITY,
+						node_id, taggroup_id, VRS_VALUE_TYPE_UINT16, 1, PARTICLE_LOOP_TAG);
+				vrs_send_tag_create(session_id, VRS_DEFAULT_PRIORITY,
+						node_id, taggroup_id, VRS_VALUE_TYPE_UINT64, 2, FRAME_TIME_TAG);
 			}
 			break;
 		}
@@ -364,6 +537,7 @@ static void cb_receive_node_create(const uint8 session_id,
 		const uint16 user_id,
 		const uint16 custom_type)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
 	struct ParticleSenderNode *sender_node;
 	struct Particle_Sender *sender;
 
@@ -410,8 +584,8 @@ static void cb_receive_node_create(const uint8 session_id,
 					sender_node->sender = sender;
 				}
 
-				/* Is it sender node created by this client */
-				if(parent_id == ctx->verse.avatar_id) {
+				/* Remember the first sender node created by this client */
+				if(ctx->sender == NULL) {
 					ctx->sender = sender;
 				}
 
@@ -428,6 +602,14 @@ static void cb_receive_node_create(const uint8 session_id,
 						node_id, PARTICLE_SENDER_TG);
 				vrs_send_layer_create(session_id, VRS_DEFAULT_PRIORITY,
 						node_id, 0xFFFF, VRS_VALUE_TYPE_REAL32, 3, PARTICLE_POS_LAYER);
+				vrs_send_layer_create(session_id, VRS_DEFAULT_PRIORITY,
+						node_id, 0xFFFF, VRS_VALUE_TYPE_UINT64, 1, TIME_REQUEST_LAYER);
+				vrs_send_layer_create(session_id, VRS_DEFAULT_PRIORITY,
+						node_id, 0xFFFF, VRS_VALUE_TYPE_UINT64, 3, TIME_RESPONSE_LAYER);
+
+				/* Receivers of other users write time requests to this node */
+				vrs_send_node_perm(session_id, VRS_DEFAULT_PRIORITY, node_id,
+						VRS_OTHER_USERS_UID, VRS_PERM_NODE_READ | VRS_PERM_NODE_WRITE);
 			}
 			break;
 		}
@@ -450,6 +632,9 @@ static void cb_receive_connect_accept(const uint8 session_id,
       const uint16 user_id,
       const uint32 avatar_id)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
+	uint32 i;
+
 #if NO_DEBUG_PRINT != 1
 	printf("%s() session_id: %d, user_id: %d, avatar_id: %d\n",
 			__FUNCTION__, session_id, user_id, avatar_id);
@@ -457,6 +642,7 @@ static void cb_receive_connect_accept(const uint8 session_id,
 
 	ctx->verse.avatar_id = avatar_id;
 	ctx->verse.user_id = user_id;
+	ctx->verse.connected = 1;
 
 	/* Subscribe to avatar node */
 	vrs_send_node_subscribe(session_id, VRS_DEFAULT_PRIORITY, avatar_id, 0, 0);
@@ -464,21 +650,31 @@ static void cb_receive_connect_accept(const uint8 session_id,
 	/* TODO: Create new particle scene node only when there is no other particle scene node */
 	vrs_send_node_create(session_id, VRS_DEFAULT_PRIORITY, PARTICLE_SCENE_NODE);
 
-	/* Create new node (particle sender node) */
-	vrs_send_node_create(session_id, VRS_DEFAULT_PRIORITY, PARTICLE_SENDER_NODE);
+	/* Create new nodes (particle sender nodes) */
+	for(i=0; i<ctx->sender_count; i++) {
+		vrs_send_node_create(session_id, VRS_DEFAULT_PRIORITY, PARTICLE_SENDER_NODE);
+	}
 }
 
 static void cb_receive_connect_terminate(const uint8 session_id,
 		const uint8 error_num)
 {
+	struct Client_CTX *ctx = session_ctx[session_id];
+
 #if NO_DEBUG_PRINT != 1
 	printf("%s() session_id: %d, error_num: %d\n",
 			__FUNCTION__, session_id, error_num);
 #else
-	(void)session_id;
 	(void)error_num;
 #endif
-	exit(EXIT_SUCCESS);
+
+	ctx->verse.connected = 0;
+
+	/* Exit, when all sessions are terminated */
+	terminated_count++;
+	if(terminated_count >= main_ctx->session_count) {
+		exit(EXIT_SUCCESS);
+	}
 }
 
 static void cb_receive_user_authenticate(const uint8 session_id,
@@ -486,7 +682,7 @@ static void cb_receive_user_authenticate(const uint8 session_id,
 		const uint8 auth_methods_count,
 		const uint8 *methods)
 {
-	static int attempts=0;	/* Store number of authentication attempt for this session. */
+	struct Client_CTX *ctx = session_ctx[session_id];
 	char name[64];
 	char *password;
 	int i, is_passwd_supported=0;
@@ -507,7 +703,7 @@ static void cb_receive_user_authenticate(const uint8 session_id,
 		if(ctx->verse.username == NULL) {
 			printf("Username: ");
 			scanf("%s", name);
-			attempts = 0;	/* Reset counter of auth. attempt. */
+			ctx->verse.auth_attempts = 0;	/* Reset counter of auth. attempt. */
 			vrs_send_user_authenticate(session_id, name, VRS_UA_METHOD_NONE, NULL);
 		} else {
 			vrs_send_user_authenticate(session_id, ctx->verse.username, VRS_UA_METHOD_NONE, NULL);
@@ -516,12 +712,12 @@ static void cb_receive_user_authenticate(const uint8 session_id,
 		if(is_passwd_supported == 1) {
 			strcpy(name, username);
 			/* Print this warning, when previous authentication attempt failed. */
-			if(attempts > 0)
+			if(ctx->verse.auth_attempts > 0)
 				printf("Permission denied, please try again.\n");
 			if(ctx->verse.password == 0) {
 				/* Get password from user */
 				password = getpass("Password: ");
-				attempts++;
+				ctx->verse.auth_attempts++;
 				vrs_send_user_authenticate(session_id, username, VRS_UA_METHOD_PASSWORD, password);
 			} else {
 				vrs_send_user_authenticate(session_id, username, VRS_UA_METHOD_PASSWORD, ctx->verse.password);
@@ -557,70 +753,251 @@ static void register_cb_func_particle_sender(void)
  * When receiver set up trigger, then sender sends particle position
  * each frame.
  */
-static void verse_send_data(void)
+static void verse_send_data(struct Client_CTX *ctx,
+		struct Particle_Sender *sender)
 {
-	if(ctx->sender == NULL) return;
+	struct TimerSnapshot timer;
 
-	pthread_mutex_lock(&ctx->sender->timer->mutex);
+	if(sender->sender_node == NULL || sender->set_items == NULL) return;
 
-	if(ctx->sender->timer->run == 1) {
-		uint16 item_id;
+	/* Read frame only once and don't block timer during sending */
+	timer_read(sender->timer, &timer);
 
-		/* Send position for current frame */
-		if(ctx->sender->timer->frame >=0 &&
-				ctx->sender->timer->frame < ctx->pd->frame_count)
+	if(timer.run == 1) {
+		uint16 item_id, loop, frame[2];
+		uint64 frame_time[2];
+		real32 marker[3];
+
+		/* When animation is at the beginning of new loop, then send number of
+		 * this loop. Receivers reset all received particles at once, but the
+		 * loop is carried by frame tag too, because this tag could arrive
+		 * after states of new loop. */
+		if(timer.tot_frame >= 0 &&
+				timer.tot_frame/(ctx->pd->frame_count - 1) != sender->loop)
 		{
+			sender->loop = timer.tot_frame/(ctx->pd->frame_count - 1);
+			loop = (uint16)sender->loop;
 
-			/* Send current frame */
 			vrs_send_tag_set_value(ctx->verse.session_id,
 					VRS_DEFAULT_PRIORITY,
-					ctx->sender->sender_node->node_id,
-					ctx->sender->sender_node->particle_taggroup_id,
-					ctx->sender->sender_node->particle_frame_tag_id,
+					sender->sender_node->node_id,
+					sender->sender_node->particle_taggroup_id,
+					sender->sender_node->loop_tag_id,
 					VRS_VALUE_TYPE_UINT16,
 					1,
-					&ctx->sender->timer->frame);
+					&loop);
+			sender->sent_cmd_count++;
+		}
+
+		/* Send position for current frame */
+		if(timer.frame >=0 &&
+				timer.frame < ctx->pd->frame_count)
+		{
+
+			/* Send current frame and its loop */
+			frame[0] = (uint16)timer.frame;
+			frame[1] = (uint16)sender->loop;
+			vrs_send_tag_set_value(ctx->verse.session_id,
+					VRS_DEFAULT_PRIORITY,
+					sender->sender_node->node_id,
+					sender->sender_node->particle_taggroup_id,
+					sender->sender_node->particle_frame_tag_id,
+					VRS_VALUE_TYPE_UINT16,
+					2,
+					frame);
+			sender->sent_cmd_count++;
+
+			/* Send time of sending this frame */
+			frame_time[0] = (uint64)timer.frame;
+			frame_time[1] = timer_get_usec();
+			vrs_send_tag_set_value(ctx->verse.session_id,
+					VRS_DEFAULT_PRIORITY,
+					sender->sender_node->node_id,
+					sender->sender_node->particle_taggroup_id,
+					sender->sender_node->frame_time_tag_id,
+					VRS_VALUE_TYPE_UINT64,
+					2,
+					frame_time);
+			sender->sent_cmd_count++;
 
 			/* For all particles of sender ... */
 			for(item_id = 0; item_id < ctx->pd->particle_count; item_id++) {
 				/* Send all active particles */
-				if(ctx->pd->particles[item_id].states[ctx->sender->timer->frame].state == PARTICLE_STATE_ACTIVE) {
+				if(ctx->pd->particles[item_id].states[timer.frame].state == PARTICLE_STATE_ACTIVE) {
 					vrs_send_layer_set_value(ctx->verse.session_id,
 							VRS_DEFAULT_PRIORITY,
-							ctx->sender->sender_node->node_id,
-							ctx->sender->sender_node->particle_layer_id,
+							sender->sender_node->node_id,
+							sender->sender_node->particle_layer_id,
 							item_id,
 							VRS_VALUE_TYPE_REAL32,
 							3,
-							ctx->pd->particles[item_id].states[ctx->sender->timer->frame].pos);
+							ctx->pd->particles[item_id].states[timer.frame].pos);
+					sender->set_items[item_id] = 1;
+					sender->sent_cmd_count++;
+				} else if(sender->set_items[item_id] == 1) {
+					/* Remove only particles set on server, which died or which
+					 * are not born in new loop yet, so layer on server (and
+					 * its snapshot for late subscribers) has no stale states */
+					vrs_send_layer_unset_value(ctx->verse.session_id,
+							VRS_DEFAULT_PRIORITY,
+							sender->sender_node->node_id,
+							sender->sender_node->particle_layer_id,
+							item_id);
+					sender->set_items[item_id] = 0;
+					sender->sent_cmd_count++;
 				}
 			}
+
+			/* Mark frame and loop of layer content after all its particles,
+			 * so snapshot of layer sent by server to late subscriber tells,
+			 * which frame it contains */
+			marker[0] = (real32)timer.frame;
+			marker[1] = (real32)sender->loop;
+			marker[2] = 0.0;
+			vrs_send_layer_set_value(ctx->verse.session_id,
+					VRS_DEFAULT_PRIORITY,
+					sender->sender_node->node_id,
+					sender->sender_node->particle_layer_id,
+					SYNC_MARKER_ITEM,
+					VRS_VALUE_TYPE_REAL32,
+					3,
+					marker);
+			sender->sent_cmd_count++;
 		}
+	}
+}
 
-		/* When animation is at the end, then "delete" particles */
-		if(ctx->sender->timer->tot_frame >=0 &&
-				ctx->sender->timer->frame == 0)
-		{
-			/* For all particles of sender ... */
-			for(item_id = 0; item_id < ctx->pd->particle_count; item_id++) {
-				/* Unset value (delete position) */
-				vrs_send_layer_unset_value(ctx->verse.session_id,
-						VRS_DEFAULT_PRIORITY,
-						ctx->sender->sender_node->node_id,
-						ctx->sender->sender_node->particle_layer_id,
-						item_id);
+/**
+ * \brief This function is executed by each worker of pool. Attached senders
+ * of all Verse sessions are split between workers according their order.
+ */
+static void send_senders_data(void *arg,
+		const uint16 worker_id,
+		const uint16 worker_count)
+{
+	uint32 i;
+
+	(void)arg;
+
+	for(i=worker_id; i<active_count; i+=worker_count) {
+		verse_send_data(active_senders[i].ctx, active_senders[i].sender);
+	}
+}
+
+/**
+ * \brief This function prints aggregated throughput of all Verse sessions
+ * and latency of sender pipeline stages
+ */
+static void print_throughput(struct Client_CTX *client_ctx,
+		uint32 *last_cmd_count,
+		struct timeval *last_tv)
+{
+	struct Client_CTX *ctx;
+	struct Particle_Sender *sender;
+	struct TimerSnapshot timer;
+	struct timeval tv;
+	uint32 cmd_count = 0, connected = 0, active = 0;
+	float duration;
+	int i;
+
+	for(i=0; i<client_ctx->session_count; i++) {
+		ctx = CLIENT_SESSION(client_ctx, i);
+		if(ctx->verse.connected == 1) {
+			connected++;
+		}
+		for(sender = ctx->senders.first; sender != NULL; sender = sender->next) {
+			timer_read(sender->timer, &timer);
+			if(timer.run == 1) {
+				active++;
 			}
+			cmd_count += sender->sent_cmd_count;
 		}
 	}
 
-	pthread_mutex_unlock(&ctx->sender->timer->mutex);
+	gettimeofday(&tv, NULL);
+	duration = (tv.tv_sec - last_tv->tv_sec) + (tv.tv_usec - last_tv->tv_usec)/(float)ONE_SECOND;
+
+	if(duration > 0) {
+		printf("Load: sessions: %u/%u, active senders: %u, commands: %.0f/s\n",
+				connected, client_ctx->session_count, active,
+				(cmd_count - *last_cmd_count)/duration);
+	}
+
+	printf("Pipeline:");
+	stage_stats_print("callbacks", &pump_stats);
+	stage_stats_print("queue", &queue_stats);
+	stage_stats_print("frames", &send_stats);
+	printf("\n");
+
+	*last_cmd_count = cmd_count;
+	*last_tv = tv;
+}
+
+/**
+ * \brief This function calls callback functions of all Verse sessions
+ */
+static void update_callbacks(struct Client_CTX *client_ctx)
+{
+	uint64 start = timer_get_usec();
+	int i;
+
+	for(i=0; i<client_ctx->session_count; i++) {
+		vrs_callback_update(CLIENT_SESSION(client_ctx, i)->verse.session_id);
+	}
+
+	stage_stats_add(&pump_stats, timer_get_usec() - start);
+}
+
+/**
+ * \brief Loop of thread calling callback functions independently on sending
+ * of particles
+ */
+static void *sender_pump_loop(void *arg)
+{
+	struct Client_CTX *client_ctx = (struct Client_CTX*)arg;
+
+	thread_sched_setup("callbacks", client_ctx->network_cpus,
+			NETWORK_RT_PRIORITY(client_ctx->rt_priority));
+
+	while(1) {
+		update_callbacks(client_ctx);
+		usleep(client_ctx->pump_interval);
+	}
+
+	return NULL;
+}
+
+/**
+ * \brief This function adds senders attached by callbacks to the list of
+ * active senders
+ */
+static void receive_sender_events(void)
+{
+	struct SenderEvent event;
+
+	while(spsc_ring_pop(event_ring, &event) == 1) {
+		stage_stats_add(&queue_stats, timer_get_usec() - event.time);
+
+		if(event.type == SENDER_EVENT_ATTACH && active_count < active_max_count) {
+			active_senders[active_count].ctx = event.ctx;
+			active_senders[active_count].sender = event.sender;
+			active_count++;
+		}
+	}
 }
 
 int particle_sender_loop(struct Client_CTX *ctx_)
 {
-	int ret;
+	struct Client_CTX *ctx;
+	struct timeval last_tv;
+	uint32 last_cmd_count = 0;
+	uint64 tick_time, last_print;
+	int i, ret;
 
-	ctx = ctx_;
+	main_ctx = ctx_;
+
+	thread_sched_setup("sender", main_ctx->network_cpus,
+			NETWORK_RT_PRIORITY(main_ctx->rt_priority));
 
 	/* Handle SIGINT signal. The handle_signal function will try to terminate
 	 * connection. */
@@ -628,17 +1005,85 @@ int particle_sender_loop(struct Client_CTX *ctx_)
 
 	register_cb_func_particle_sender();
 
-	if((ret = vrs_send_connect_request(ctx->verse.server_name, "12345",
-			VRS_SEC_DATA_NONE ,&ctx->verse.session_id))!=VRS_SUCCESS) {
-		printf("ERROR: %s\n", vrs_strerror(ret));
+	/* Create queue of events and list of senders used by sending thread */
+	active_max_count = main_ctx->session_count * main_ctx->sender_count;
+	active_senders = (struct ActiveSender*)calloc(active_max_count, sizeof(struct ActiveSender));
+	event_ring = spsc_ring_create(2*active_max_count, sizeof(struct SenderEvent));
+	if(active_senders == NULL || event_ring == NULL) {
+		printf("ERROR: unable to allocate list of senders\n");
 		return 0;
 	}
 
+	/* Connect all Verse sessions */
+	for(i=0; i<main_ctx->session_count; i++) {
+		ctx = CLIENT_SESSION(main_ctx, i);
+		if((ret = vrs_send_connect_request(ctx->verse.server_name, "12345",
+				VRS_SEC_DATA_NONE ,&ctx->verse.session_id))!=VRS_SUCCESS) {
+			printf("ERROR: %s\n", vrs_strerror(ret));
+			return 0;
+		}
+		session_ctx[ctx->verse.session_id] = ctx;
+	}
+
+	/* Call callbacks in separate thread, when it is required */
+	if(main_ctx->pump_interval > 0) {
+		if(pthread_create(&main_ctx->pump_thread, NULL, sender_pump_loop, (void*)main_ctx) != 0) {
+			printf("ERROR: unable to create thread calling callbacks\n");
+			return 0;
+		}
+	}
+
+	gettimeofday(&last_tv, NULL);
+	last_print = timer_get_usec();
+
+	tick_consumer_init(&send_ticks, "sender");
+
 	/* Never ending loop */
 	while(1) {
-		sem_wait(&ctx->timer_sem);
-		vrs_callback_update(ctx->verse.session_id);
-		verse_send_data();
+		/* Virtual clock doesn't tick without attached sender. The first frame
+		 * is requested, when some sender is attached. */
+		if((main_ctx->flags & VC_VIRTUAL_CLOCK) && active_count == 0) {
+			if(main_ctx->pump_interval == 0) {
+				update_callbacks(main_ctx);
+			}
+			receive_sender_events();
+			if(active_count == 0) {
+				usleep(DEFAULT_PUMP_INTERVAL);
+				continue;
+			}
+			sem_post(&main_ctx->frame_sem);
+		}
+
+		tick_consumer_wait(&send_ticks);
+		tick_time = timer_get_usec();
+
+		/* Call callbacks once per frame in this thread */
+		if(main_ctx->pump_interval == 0) {
+			update_callbacks(main_ctx);
+		}
+
+		receive_sender_events();
+
+		/* Send data of all senders using pool of workers */
+		worker_pool_run(main_ctx->worker_pool, send_senders_data, NULL);
+
+		stage_stats_add(&send_stats, timer_get_usec() - tick_time);
+
+		/* Let virtual clock start next frame */
+		if(main_ctx->flags & VC_VIRTUAL_CLOCK) {
+			sem_post(&main_ctx->frame_sem);
+		}
+
+		/* Print throughput and latencies once per second. Ticks of timer
+		 * are reported in every mode. */
+		if(tick_time - last_print >= ONE_SECOND) {
+			if(main_ctx->session_count > 1 || main_ctx->sender_count > 1 ||
+					(main_ctx->flags & VC_VIRTUAL_CLOCK)) {
+				print_throughput(main_ctx, &last_cmd_count, &last_tv);
+			}
+			timer_stats_print();
+			last_print = tick_time;
+		}
 	}
 
 	return 1;
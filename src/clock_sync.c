@@ -0,0 +1,177 @@
+/*
+ * $Id$
+ *
+ * ***** BEGIN BSD LICENSE BLOCK *****
+ *
+ * Copyright (c) 2009-2011, Jiri Hnidek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ***** END BSD LICENSE BLOCK *****
+ *
+ * Authors: Jiri Hnidek <jiri.hnidek@tul.cz>
+ *
+ */
+
+#include <stdio.h>
+
+#include <verse.h>
+
+#include "clock_sync.h"
+#include "client.h"
+#include "sender.h"
+#include "particle_sender_node.h"
+#include "particle_data.h"
+#include "timer.h"
+
+/**
+ * \brief This function initializes estimation of sender clock
+ */
+void clock_sync_init(struct ClockSync *sync)
+{
+	sync->request_time = 0;
+	sync->last_request = 0;
+	sync->sample_count = 0;
+	sync->next_sample = 0;
+	sync->first_offset = 0;
+	sync->first_time = 0;
+	__atomic_store_n(&sync->valid, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&sync->offset, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&sync->rtt, 0, __ATOMIC_RELAXED);
+	sync->drift = 0.0;
+}
+
+/**
+ * \brief This function returns 1, when new time request should be sent at
+ * time now. Request without response is sent again after the period too.
+ */
+int clock_sync_request(struct ClockSync *sync,
+		const uint64 now)
+{
+	if(sync->last_request != 0 && now - sync->last_request < CLOCK_SYNC_PERIOD) {
+		return 0;
+	}
+
+	sync->request_time = now;
+	sync->last_request = now;
+
+	return 1;
+}
+
+/**
+ * \brief This function adds response to time request. Times are: time of
+ * sending request (receiver clock), time of receiving request and time of
+ * sending response (sender clock). Offset is taken from the sample with
+ * minimal round trip time, because it is least affected by queuing. It
+ * returns 1, when response matched pending request.
+ */
+int clock_sync_response(struct ClockSync *sync,
+		const uint64 times[3],
+		const uint64 now)
+{
+	struct ClockSample *sample, *best;
+	int64 processing;
+	real32 drift;
+	int i;
+
+	/* Response to request of other receiver or to older request */
+	if(sync->request_time == 0 || times[0] != sync->request_time) {
+		return 0;
+	}
+	sync->request_time = 0;
+
+	processing = (int64)(times[2] - times[1]);
+	if(processing < 0 || (int64)(now - times[0]) < processing) {
+		return 0;
+	}
+
+	sample = &sync->samples[sync->next_sample];
+	sample->rtt = (now - times[0]) - processing;
+	sample->offset = (((int64)times[1] - (int64)times[0]) +
+			((int64)times[2] - (int64)now)) / 2;
+	sample->time = now;
+
+	sync->next_sample = (sync->next_sample + 1) % CLOCK_SYNC_SAMPLES;
+	if(sync->sample_count < CLOCK_SYNC_SAMPLES) {
+		sync->sample_count++;
+	}
+
+	/* Minimal round trip time filter */
+	best = &sync->samples[0];
+	for(i=1; i<sync->sample_count; i++) {
+		if(sync->samples[i].rtt < best->rtt) {
+			best = &sync->samples[i];
+		}
+	}
+
+	if(sync->first_time == 0) {
+		sync->first_offset = best->offset;
+		sync->first_time = best->time;
+	} else if(best->time > sync->first_time) {
+		drift = 1000000.0*(best->offset - sync->first_offset)/(real32)(best->time - sync->first_time);
+		__atomic_store(&sync->drift, &drift, __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(&sync->offset, best->offset, __ATOMIC_RELAXED);
+	__atomic_store_n(&sync->rtt, (uint32)best->rtt, __ATOMIC_RELAXED);
+	__atomic_store_n(&sync->valid, 1, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+/**
+ * \brief This function sends time requests to all senders, which have to be
+ * synchronized. It has to be called from thread calling Verse callbacks.
+ */
+void update_clock_sync(struct Client_CTX *ctx)
+{
+	struct ParticleSenderNode *sender_node;
+	struct ReceivedParticleData *rpd;
+	uint64 now;
+
+	if(ctx->verse.particle_scene_node == NULL) {
+		return;
+	}
+
+	for(sender_node = ctx->verse.particle_scene_node->senders.first;
+			sender_node != NULL;
+			sender_node = sender_node->next)
+	{
+		if(sender_node->sender == NULL ||
+				(rpd = sender_node->sender->rec_pd) == NULL ||
+				sender_node->time_req_layer_id == (uint16)-1 ||
+				sender_node->time_resp_layer_id == (uint16)-1) {
+			continue;
+		}
+
+		/* Each receiver uses its own item (ID of its avatar), so requests
+		 * of more receivers don't overwrite each other */
+		now = timer_get_usec();
+		if(clock_sync_request(&rpd->clock, now) == 1) {
+			vrs_send_layer_set_value(ctx->verse.session_id, VRS_DEFAULT_PRIORITY,
+					sender_node->node_id, sender_node->time_req_layer_id,
+					ctx->verse.avatar_id, VRS_VALUE_TYPE_UINT64, 1, &now);
+		}
+	}
+}
@@ -42,6 +42,7 @@
 
 #include <sys/time.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 
 #include <verse.h>
@@ -50,9 +51,16 @@
 #include "client.h"
 #include "display_glut.h"
 #include "math_lib.h"
+#include "timer.h"
 
 static struct Client_CTX *ctx = NULL;
 
+/* Ticks of timer driving redisplay */
+static struct TickConsumer display_ticks;
+
+/* Number of polls of ticks during one frame */
+#define DISPLAY_TICK_POLLS	4
+
 /**
  * \brief Initialize OpenGL context
  */
@@ -257,26 +265,27 @@ static void display_particle(float *pos, float size, const uint8 *col, const uin
 /**
  * \brief This function try to display received particle
  */
-static void display_rec_particle_simple(struct ReceivedParticle *rec_particle,
+static void display_rec_particle_simple(struct RefParticle *ref_particle,
+		struct RenderParticle *render_particle,
 		int current_frame)
 {
-	if(rec_particle->current_received_state != NULL) {
-		switch(rec_particle->current_received_state->state) {
+	if(render_particle->cur_frame != -1) {
+		switch(render_particle->cur_state) {
 		case RECEIVED_STATE_INTIME:
 		case RECEIVED_STATE_AHEAD:
-			display_particle(rec_particle->current_received_state->ref_particle_state->pos,
+			display_particle(ref_particle->states[render_particle->cur_frame].pos,
 					2.0,
 					yellow_col,
 					1);
 			break;
 		case RECEIVED_STATE_DELAY:
-			if(rec_particle->current_received_state->ref_particle_state->frame < rec_particle->ref_particle->die_frame-1) {
-				display_particle(rec_particle->current_received_state->ref_particle_state->pos,
+			if(render_particle->cur_frame < ref_particle->die_frame-1) {
+				display_particle(ref_particle->states[render_particle->cur_frame].pos,
 						4.0,
 						red_col,
 						1);
 			}
-			display_particle(rec_particle->ref_particle->states[current_frame].pos,
+			display_particle(ref_particle->states[current_frame].pos,
 					2.0,
 					white_col,
 					1);
@@ -286,8 +295,8 @@ static void display_rec_particle_simple(struct ReceivedParticle *rec_particle,
 			break;
 		}
 
-	} else if(rec_particle->ref_particle->born_frame <= current_frame) {
-		display_particle(rec_particle->ref_particle->states[rec_particle->ref_particle->born_frame].pos,
+	} else if(ref_particle->born_frame <= current_frame) {
+		display_particle(ref_particle->states[ref_particle->born_frame].pos,
 						4.0,
 						red_col,
 						1);
@@ -298,72 +307,79 @@ static void display_rec_particle_simple(struct ReceivedParticle *rec_particle,
  * \brief This function display line with delay between currently received
  * particle position and expected particle position
  */
-static void display_rec_particle_lines(struct ReceivedParticle *rec_particle,
+static void display_rec_particle_lines(struct RefParticle *ref_particle,
+		struct RenderParticle *render_particle,
 		int current_frame)
 {
 	int frame;
 
-	if(rec_particle->ref_particle->states[current_frame].state != PARTICLE_STATE_UNBORN &&
-			rec_particle->last_received_state != NULL) {
+	if(ref_particle->states[current_frame].state != PARTICLE_STATE_UNBORN &&
+			render_particle->last_frame != -1) {
 		struct HSV_Color hsv;
 		struct RGB_Color rgb;
+		float *last_pos = ref_particle->states[render_particle->last_frame].pos;
 		float dist, dx, dy, dz;
 		hsv.s = 1.0;
 		hsv.v = 1.0;
 
 		glBegin(GL_LINE_STRIP);
-		for(frame = rec_particle->last_received_state->ref_particle_state->frame;
+		for(frame = render_particle->last_frame;
 				frame < current_frame;
 				frame++)
 		{
-			dx = rec_particle->last_received_state->ref_particle_state->pos[0] - rec_particle->ref_particle->states[frame].pos[0];
-			dy = rec_particle->last_received_state->ref_particle_state->pos[1] - rec_particle->ref_particle->states[frame].pos[1];
-			dz = rec_particle->last_received_state->ref_particle_state->pos[2] - rec_particle->ref_particle->states[frame].pos[2];
+			dx = last_pos[0] - ref_particle->states[frame].pos[0];
+			dy = last_pos[1] - ref_particle->states[frame].pos[1];
+			dz = last_pos[2] - ref_particle->states[frame].pos[2];
 
 			dist = sqrt(dx*dx + dy*dy + dz*dz);
 			hsv.h = (dist<10) ? 0.1*dist : 1.0;
 			hsv2rgb(&hsv, &rgb);
 
 			glColor3f(rgb.r, rgb.g, rgb.b);
-			glVertex3fv(rec_particle->ref_particle->states[frame].pos);
+			glVertex3fv(ref_particle->states[frame].pos);
 		}
 		glEnd();
 	}
 }
 
 /**
- * \brief This function display history of received particles
+ * \brief This function display history of received particles. History is
+ * read without locking, because packed states are updated atomically by
+ * ingest thread.
  */
-static void display_rec_particle_dots(struct ReceivedParticle *rec_particle,
+static void display_rec_particle_dots(struct ReceivedParticleData *rpd,
+		const uint16 generation,
+		const uint16 item_id,
 		int current_frame)
 {
+	struct RefParticle *ref_particle = rpd->received_particles[item_id].ref_particle;
 	int frame;
 
-	if(rec_particle->ref_particle->states[current_frame].state != PARTICLE_STATE_UNBORN) {
+	if(ref_particle->states[current_frame].state != PARTICLE_STATE_UNBORN) {
 
 		glColor3ubv(gray_col);
 		glBegin(GL_LINE_STRIP);
-		for(frame=rec_particle->ref_particle->born_frame; frame<current_frame; frame++) {
-			glVertex3fv(rec_particle->received_states[frame].ref_particle_state->pos);
+		for(frame=ref_particle->born_frame; frame<current_frame; frame++) {
+			glVertex3fv(ref_particle->states[frame].pos);
 		}
 		glEnd();
 
-		for(frame=rec_particle->ref_particle->born_frame; frame<current_frame; frame++) {
-			switch(rec_particle->received_states[frame].state) {
+		for(frame=ref_particle->born_frame; frame<current_frame; frame++) {
+			switch(get_received_state(rpd, generation, item_id, frame)) {
 			case RECEIVED_STATE_UNRECEIVED:
-				display_particle(rec_particle->received_states[frame].ref_particle_state->pos,
+				display_particle(ref_particle->states[frame].pos,
 						2.0,
 						red_col,
 						0);
 				break;
 			case RECEIVED_STATE_DELAY:
-				display_particle(rec_particle->received_states[frame].ref_particle_state->pos,
+				display_particle(ref_particle->states[frame].pos,
 						2.0,
 						orange_col,
 						0);
 				break;
 			case RECEIVED_STATE_INTIME:
-				display_particle(rec_particle->received_states[frame].ref_particle_state->pos,
+				display_particle(ref_particle->states[frame].pos,
 						2.0,
 						green_col,
 						0);
@@ -377,10 +393,56 @@ static void display_rec_particle_dots(struct ReceivedParticle *rec_particle,
 }
 
 /**
- * \brief This function displays received particle system
+ * \brief This function displays predicted position of particle, which was
+ * not received at current frame. Displayed position is smoothed with
+ * exponential smoothing.
+ */
+static void display_rec_particle_predicted(struct Particle_Sender *sender,
+		struct ReceivedParticleData *rpd,
+		int item_id,
+		int current_frame)
+{
+	struct DisplayParticle *disp = &sender->display_particles[item_id];
+	float pos[3];
+	int ret;
+
+	ret = predict_received_particle(rpd, item_id, current_frame,
+			ctx->predict_frames, pos);
+
+	if(ret == PREDICT_NONE) {
+		disp->valid = 0;
+		return;
+	}
+
+	if(disp->valid == 1) {
+		disp->pos[0] += ctx->smoothing*(pos[0] - disp->pos[0]);
+		disp->pos[1] += ctx->smoothing*(pos[1] - disp->pos[1]);
+		disp->pos[2] += ctx->smoothing*(pos[2] - disp->pos[2]);
+	} else {
+		disp->pos[0] = pos[0];
+		disp->pos[1] = pos[1];
+		disp->pos[2] = pos[2];
+		disp->valid = 1;
+	}
+
+	/* Received positions are displayed by display_rec_particle_simple() */
+	if(ret != PREDICT_RECEIVED) {
+		display_particle(disp->pos, 3.0, blue_col, 1);
+	}
+}
+
+/**
+ * \brief This function displays received particle system. It uses snapshot
+ * published by ingest thread and it never waits for receiving of data.
  */
 static void display_rec_particle_system(struct Particle_Sender *sender)
 {
+	struct TimerSnapshot timer;
+	struct ReceivedParticleData *rpd;
+	struct RenderSnapshot *snapshot;
+	struct RefParticle *ref_particle;
+	struct RenderParticle *render_particle;
+	uint16 generation;
 	int i, current_frame, received_frame;
 	int tmp;
 	char str_frame[MAX_STR_LEN];
@@ -390,15 +452,27 @@ static void display_rec_particle_system(struct Particle_Sender *sender)
 	pos[1] = sender->pos[1] + 4;
 	pos[2] = sender->pos[2] + 3.1;
 
-	pthread_mutex_lock(&sender->rec_pd->mutex);
+	/* Sender node wasn't bound to this sender yet or it is out of interest */
+	if((rpd = __atomic_load_n(&sender->rec_pd, __ATOMIC_ACQUIRE)) == NULL ||
+			__atomic_load_n(&sender->interest, __ATOMIC_RELAXED) == 0) {
+		return;
+	}
+
+	snapshot = read_received_particle_data(rpd);
+	generation = get_received_generation(rpd);
+
+	/* Create smoothed positions of predicted particles */
+	if(ctx->predict_frames > 0 && sender->display_particles == NULL) {
+		sender->display_particles = (struct DisplayParticle*)calloc(ctx->pd->particle_count,
+				sizeof(struct DisplayParticle));
+	}
 
 	/* Get received frame */
-	received_frame = sender->rec_pd->rec_frame;
+	received_frame = snapshot->rec_frame;
 
 	/* Get current frame */
-	pthread_mutex_lock(&sender->timer->mutex);
-	current_frame = sender->timer->frame;
-	pthread_mutex_unlock(&sender->timer->mutex);
+	timer_read(sender->timer, &timer);
+	current_frame = timer.frame;
 
 	/* Display current frame */
 	tmp = snprintf(str_frame, MAX_STR_LEN-1, "%d", current_frame);
@@ -419,32 +493,35 @@ static void display_rec_particle_system(struct Particle_Sender *sender)
 	glTranslatef(sender->pos[0], sender->pos[1], sender->pos[2]);
 
 	/* Display particle system only in situation, when animation was started */
-	if(current_frame >= 0) {
+	if(current_frame >= 0 && snapshot->particles != NULL) {
 		for(i=0; i<ctx->pd->particle_count; i++) {
+			ref_particle = &ctx->pd->particles[i];
+			render_particle = &snapshot->particles[i];
 			switch(ctx->display->visual_type) {
 			case VISUAL_DOT:
-				display_rec_particle_dots(&sender->rec_pd->received_particles[i], current_frame);
-				display_rec_particle_simple(&sender->rec_pd->received_particles[i], current_frame);
+				display_rec_particle_dots(rpd, generation, i, current_frame);
+				display_rec_particle_simple(ref_particle, render_particle, current_frame);
 				break;
 			case VISUAL_LINE:
-				display_rec_particle_lines(&sender->rec_pd->received_particles[i], current_frame);
-				display_rec_particle_simple(&sender->rec_pd->received_particles[i], current_frame);
+				display_rec_particle_lines(ref_particle, render_particle, current_frame);
+				display_rec_particle_simple(ref_particle, render_particle, current_frame);
 				break;
 			case VISUAL_DOT_LINE:
-				display_rec_particle_dots(&sender->rec_pd->received_particles[i], current_frame);
-				display_rec_particle_lines(&sender->rec_pd->received_particles[i], current_frame);
-				display_rec_particle_simple(&sender->rec_pd->received_particles[i], current_frame);
+				display_rec_particle_dots(rpd, generation, i, current_frame);
+				display_rec_particle_lines(ref_particle, render_particle, current_frame);
+				display_rec_particle_simple(ref_particle, render_particle, current_frame);
 				break;
 			case VISUAL_SIMPLE:
-				display_rec_particle_simple(&sender->rec_pd->received_particles[i], current_frame);
+				display_rec_particle_simple(ref_particle, render_particle, current_frame);
 				break;
 			}
+			if(sender->display_particles != NULL) {
+				display_rec_particle_predicted(sender, rpd, i, current_frame);
+			}
 		}
 	}
 
 	glTranslatef(-sender->pos[0], -sender->pos[1], -sender->pos[2]);
-
-	pthread_mutex_unlock(&sender->rec_pd->mutex);
 }
 
 
@@ -533,11 +610,24 @@ static void glut_on_display(void)
 }
 
 /**
- * \brief Display particles in regular periods
+ * \brief This function returns interval of polling of ticks in milliseconds
+ */
+static unsigned int display_poll_interval(void)
+{
+	unsigned int interval = (unsigned int)(1000/(DISPLAY_TICK_POLLS*ctx->verse.fps*ctx->time_scale));
+
+	return (interval > 0) ? interval : 1;
+}
+
+/**
+ * \brief Display particles, when timer broadcasted new frame. Frames missed
+ * by display are coalesced to one redisplay.
  */
 static void glut_on_timer(int value) {
-	glutPostRedisplay();
-	glutTimerFunc(1000/ctx->verse.fps, glut_on_timer, value);	/* TODO: timer */
+	if(tick_consumer_poll(&display_ticks) > 0) {
+		glutPostRedisplay();
+	}
+	glutTimerFunc(display_poll_interval(), glut_on_timer, value);
 }
 
 /**
@@ -733,7 +823,8 @@ static void glut_init(int argc, char *argv[])
 	glutKeyboardFunc(glut_on_keyboard);
 	glutMouseFunc(glut_on_mouse_click);
 	glutMotionFunc(glut_on_mouse_drag);
-	glutTimerFunc(1000/ctx->verse.fps, glut_on_timer, 0);
+	tick_consumer_init(&display_ticks, "display");
+	glutTimerFunc(display_poll_interval(), glut_on_timer, 0);
 	gl_init();
 }
 
@@ -0,0 +1,343 @@
+/*
+ * $Id$
+ *
+ * ***** BEGIN BSD LICENSE BLOCK *****
+ *
+ * Copyright (c) 2009-2011, Jiri Hnidek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ***** END BSD LICENSE BLOCK *****
+ *
+ * Authors: Jiri Hnidek <jiri.hnidek@tul.cz>
+ *
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "ingest.h"
+#include "client.h"
+#include "sender.h"
+#include "timer.h"
+#include "worker_pool.h"
+
+/**
+ * \brief This function adds record to the ring of received particle data. It
+ * can be called only from thread calling Verse callbacks. It returns 1, when
+ * record was added and 0, when ring was full and record was dropped.
+ */
+int ingest_push(struct ReceivedParticleData *rpd,
+		const struct IngestRecord *record)
+{
+	/* Sender node isn't bound to any sender */
+	if(rpd == NULL) {
+		return 0;
+	}
+
+	if(rpd->ingest_ring == NULL ||
+			spsc_ring_push(rpd->ingest_ring, record) == 0) {
+		__atomic_add_fetch(&rpd->ingest_drops, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * \brief This function forgets all particles received in previous loop of
+ * animation, when loop is newer than the current one. Loop tag resent or
+ * reordered after frame of new loop is ignored. The first loop known after
+ * reset only sets the current loop, because data were reset already and they
+ * could be seeded by snapshot of layer.
+ */
+static void ingest_loop(struct ReceivedParticleData *rpd,
+		const uint16 loop)
+{
+	if(rpd->loop == -1) {
+		rpd->loop = loop;
+	} else if((int16)(loop - (uint16)rpd->loop) > 0) {
+		reset_received_particle_data(rpd);
+		rpd->loop = loop;
+	}
+}
+
+/**
+ * \brief This function applies values received before marker of layer
+ * snapshot, when frame and loop of snapshot are known. Values of snapshot
+ * frame seed received data, stale values are dropped and values of newer
+ * frames are applied as live updates.
+ */
+static void ingest_sync(struct ReceivedParticleData *rpd,
+		const struct IngestRecord *marker)
+{
+	struct IngestRecord *record;
+	uint32 i;
+
+	ingest_loop(rpd, marker->loop);
+
+	/* Snapshot of previous loop doesn't seed data of current loop */
+	if((uint16)rpd->loop == marker->loop) {
+		rpd->sync_frame = marker->frame;
+		if(rpd->rec_frame < 0) {
+			rpd->rec_frame = marker->frame;
+		}
+	}
+
+	for(i=0; i<rpd->sync_count; i++) {
+		record = &rpd->sync_values[i];
+		/* Values received before start of timer arrived in snapshot frame */
+		if(apply_received_particle_state(rpd, record->item_id,
+				(record->frame >= 0) ? record->frame : marker->frame,
+				record->time, record->pos) == 0) {
+			printf("ERROR: Reference particle state not found\n");
+		}
+	}
+	rpd->sync_count = 0;
+}
+
+/**
+ * \brief This function applies one record to the received particle data
+ */
+static void ingest_apply_record(struct ReceivedParticleData *rpd,
+		const struct IngestRecord *record)
+{
+	switch(record->type) {
+	case INGEST_SET_VALUE:
+		if(apply_received_particle_state(rpd, record->item_id,
+				record->frame, record->time, record->pos) == 0) {
+			printf("ERROR: Reference particle state not found\n");
+		}
+		break;
+	case INGEST_UNSET_VALUE:
+		unset_received_particle(rpd, record->item_id);
+		break;
+	case INGEST_FRAME:
+		/* Frame of new loop resets data before states of this frame */
+		ingest_loop(rpd, record->loop);
+		rpd->rec_frame = record->frame;
+		break;
+	case INGEST_FRAME_TIME:
+		if(record->frame >= 0 && record->frame < rpd->ref_particle_data->frame_count) {
+			rpd->frame_times[record->frame] = record->time;
+		}
+		break;
+	case INGEST_LOOP:
+		ingest_loop(rpd, (uint16)record->frame);
+		break;
+	case INGEST_BIND:
+		/* Statistics of previous sender node are not valid for new one.
+		 * Statistics thread detects reset by change of binding. */
+		__atomic_add_fetch(&rpd->binding, 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		receiver_stats_init(&rpd->stats);
+		__atomic_store_n(&rpd->ingest_drops, 0, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&rpd->binding, 1, __ATOMIC_RELEASE);
+		/* fall through */
+	case INGEST_RESET:
+		/* Data were reused for new sender node or sender entered interest */
+		reset_received_particle_data(rpd);
+		rpd->loop = -1;
+		rpd->rec_frame = -1;
+		rpd->checked_frame = -1;
+		rpd->sync_count = 0;
+		break;
+	case INGEST_SYNC_VALUE:
+		/* Frame of snapshot isn't known yet */
+		if(rpd->sync_count < rpd->sync_max_count) {
+			rpd->sync_values[rpd->sync_count++] = *record;
+		} else {
+			__atomic_add_fetch(&rpd->ingest_drops, 1, __ATOMIC_RELAXED);
+		}
+		break;
+	case INGEST_SYNC_MARK:
+		ingest_sync(rpd, record);
+		break;
+	}
+}
+
+/**
+ * \brief This function applies all records waiting in the ring to the
+ * received particle data. Records are copied out of the ring in batches and
+ * only ingest worker owning shard of data applies them, so data are not
+ * locked. It returns number of applied records.
+ */
+uint32 ingest_apply(struct ReceivedParticleData *rpd)
+{
+	struct IngestRecord records[INGEST_BATCH_SIZE];
+	uint32 i, count, total = 0;
+
+	if(rpd->ingest_ring == NULL) {
+		return 0;
+	}
+
+	do {
+		/* Copy batch of records out of the ring without locking */
+		count = 0;
+		while(count < INGEST_BATCH_SIZE &&
+				spsc_ring_pop(rpd->ingest_ring, &records[count]) == 1) {
+			count++;
+		}
+
+		for(i=0; i<count; i++) {
+			ingest_apply_record(rpd, &records[i]);
+		}
+
+		total += count;
+	} while(count == INGEST_BATCH_SIZE);
+
+	return total;
+}
+
+/**
+ * \brief This function predicts positions of particles, which were not
+ * received at finished frame and it compares them with reference positions
+ */
+static void ingest_check_prediction(struct ReceivedParticleData *rpd,
+		const int16 frame,
+		const uint16 horizon)
+{
+	struct RefParticleData *pd = rpd->ref_particle_data;
+	struct RefParticleState *ref_state;
+	real32 pos[3], dx, dy, dz;
+	int i, ret;
+
+	/* All active particles of this frame were received */
+	if(received_count_in_frame(rpd, rpd->generation, frame) >= pd->active_counts[frame]) {
+		return;
+	}
+
+	for(i=0; i<pd->particle_count; i++) {
+		ref_state = &pd->particles[i].states[frame];
+		if(ref_state->state != PARTICLE_STATE_ACTIVE ||
+				get_received_state(rpd, rpd->generation, i, frame) != RECEIVED_STATE_UNRECEIVED) {
+			continue;
+		}
+
+		ret = predict_received_particle(rpd, i, frame, horizon, pos);
+		dx = pos[0] - ref_state->pos[0];
+		dy = pos[1] - ref_state->pos[1];
+		dz = pos[2] - ref_state->pos[2];
+		receiver_stats_add_prediction(&rpd->stats, ret,
+				(ret != PREDICT_NONE) ? sqrt(dx*dx + dy*dy + dz*dz) : 0.0);
+	}
+}
+
+/**
+ * \brief This function applies received records to the received particle
+ * data of one sender
+ */
+static void ingest_sender(struct Client_CTX *ctx,
+		struct Particle_Sender *sender,
+		struct ReceivedParticleData *rpd)
+{
+	struct TimerSnapshot timer;
+	uint32 count;
+
+	timer_read(sender->timer, &timer);
+
+	count = ingest_apply(rpd);
+
+	/* Release states from jitter buffer in frame order */
+	if(rpd->jitter.max_depth > 0 && timer.run == 1) {
+		jitter_buffer_release(rpd, timer.frame);
+		count++;
+	}
+
+	/* Publish snapshot for renderer at frame boundary */
+	if(count > 0) {
+		publish_received_particle_data(rpd);
+	}
+
+	/* States of sender out of interest are not expected */
+	if(__atomic_load_n(&sender->interest, __ATOMIC_RELAXED) == 0) {
+		rpd->stats.last_tot_frame = timer.tot_frame;
+		return;
+	}
+
+	/* Measure error of prediction at previous (finished) frame */
+	if(ctx->predict_frames > 0 && timer.run == 1 && timer.frame > 0 &&
+			timer.frame != rpd->checked_frame) {
+		ingest_check_prediction(rpd, timer.frame - 1, ctx->predict_frames);
+		rpd->checked_frame = timer.frame;
+	}
+
+	/* States of snapshot frame seeded received data, so they are not expected */
+	if(timer.run == 1 && rpd->stats.last_tot_frame == -1 &&
+			timer.frame == rpd->sync_frame) {
+		rpd->stats.last_tot_frame = timer.tot_frame;
+	}
+
+	/* Count states sent by sender till current frame */
+	if(timer.run == 1) {
+		receiver_stats_add_frames(&rpd->stats, ctx->pd, timer.tot_frame);
+	}
+}
+
+/**
+ * \brief This function is executed by each worker of pool. Received data
+ * of senders of all Verse sessions are sharded between workers by shard of
+ * data, so each worker is the only consumer of ingest rings and owner of its
+ * received data, even when data are bound to other sender during job.
+ */
+static void ingest_senders(void *arg,
+		const uint16 worker_id,
+		const uint16 worker_count)
+{
+	struct Client_CTX *ctx = (struct Client_CTX*)arg;
+	struct Client_CTX *session;
+	struct Particle_Sender *sender;
+	struct ReceivedParticleData *rpd;
+	int i;
+
+	for(i=0; i<ctx->session_count; i++) {
+		session = CLIENT_SESSION(ctx, i);
+		for(sender = session->senders.first; sender != NULL; sender = sender->next) {
+			rpd = __atomic_load_n(&sender->rec_pd, __ATOMIC_ACQUIRE);
+			if(rpd != NULL && rpd->shard % worker_count == worker_id) {
+				ingest_sender(session, sender, rpd);
+			}
+		}
+	}
+}
+
+/**
+ * \brief Main loop of thread applying received records to the received
+ * particle data of all senders. Work is split between workers of pool.
+ */
+void *particle_ingest_loop(void *arg)
+{
+	struct Client_CTX *ctx = (struct Client_CTX*)arg;
+
+	while(1) {
+		/* Wait for next update of Verse callbacks */
+		sem_wait(&ctx->ingest_sem);
+
+		worker_pool_run(ctx->worker_pool, ingest_senders, ctx);
+	}
+
+	return NULL;
+}
@@ -0,0 +1,212 @@
+/*
+ * $Id$
+ *
+ * ***** BEGIN BSD LICENSE BLOCK *****
+ *
+ * Copyright (c) 2009-2011, Jiri Hnidek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ***** END BSD LICENSE BLOCK *****
+ *
+ * Authors: Jiri Hnidek <jiri.hnidek@tul.cz>
+ *
+ */
+
+#include <stdio.h>
+#include <math.h>
+
+#include <verse.h>
+
+#include "interest.h"
+#include "client.h"
+#include "sender.h"
+#include "particle_sender_node.h"
+#include "display_glut.h"
+#include "math_lib.h"
+#include "ingest.h"
+
+/**
+ * \brief This function returns 1, when receiver subscribes only to layers
+ * of senders in interest of camera. Otherwise it returns 0.
+ */
+int interest_is_enabled(struct Client_CTX *ctx)
+{
+	return ctx->display != NULL &&
+			(ctx->interest_radius > 0.0 || ctx->interest_frustum == 1);
+}
+
+/**
+ * \brief This function tests, if sphere is closer to camera than radius
+ */
+static int interest_in_radius(const struct Camera *camera,
+		const real32 center[3],
+		const real32 sphere_radius,
+		const real32 radius)
+{
+	real32 rel[3];
+
+	rel[0] = center[0] - camera->pos[0];
+	rel[1] = center[1] - camera->pos[1];
+	rel[2] = center[2] - camera->pos[2];
+
+	return sqrt(rel[0]*rel[0] + rel[1]*rel[1] + rel[2]*rel[2]) <= radius + sphere_radius;
+}
+
+/**
+ * \brief This function tests, if sphere intersects view frustum of camera
+ */
+static int interest_in_frustum(const struct Camera *camera,
+		const real32 aspect,
+		const real32 center[3],
+		const real32 sphere_radius)
+{
+	real32 forward[3], right[3], up[3], rel[3];
+	real32 x, y, z, tan_x, tan_y;
+
+	forward[0] = camera->target[0] - camera->pos[0];
+	forward[1] = camera->target[1] - camera->pos[1];
+	forward[2] = camera->target[2] - camera->pos[2];
+	if(vector_normalize(forward) == 0.0) {
+		return 1;
+	}
+
+	up[0] = camera->up[0];
+	up[1] = camera->up[1];
+	up[2] = camera->up[2];
+	vector_cross(forward, up, right);
+	if(vector_normalize(right) == 0.0) {
+		return 1;
+	}
+	vector_cross(right, forward, up);
+
+	/* Position of sphere in coordinates of camera */
+	rel[0] = center[0] - camera->pos[0];
+	rel[1] = center[1] - camera->pos[1];
+	rel[2] = center[2] - camera->pos[2];
+	x = rel[0]*right[0] + rel[1]*right[1] + rel[2]*right[2];
+	y = rel[0]*up[0] + rel[1]*up[1] + rel[2]*up[2];
+	z = rel[0]*forward[0] + rel[1]*forward[1] + rel[2]*forward[2];
+
+	/* Near and far clipping plane */
+	if(z < camera->near_clipping_plane - sphere_radius ||
+			z > camera->far_clipping_plane + sphere_radius) {
+		return 0;
+	}
+
+	/* Side planes: distance of center from plane has to be lower than radius */
+	tan_y = tan(0.5*camera->field_of_view*M_PI/180.0);
+	tan_x = tan_y*aspect;
+	if(fabs(y) - z*tan_y > sphere_radius*sqrt(1.0 + tan_y*tan_y) ||
+			fabs(x) - z*tan_x > sphere_radius*sqrt(1.0 + tan_x*tan_x)) {
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * \brief This function subscribes to particle layer of sender node, when
+ * interest management is disabled. Otherwise layer is subscribed by
+ * update_interest(), when sender is in interest.
+ */
+void interest_subscribe_sender(struct Client_CTX *ctx,
+		struct ParticleSenderNode *sender_node)
+{
+	if(interest_is_enabled(ctx) == 0 && sender_node->layer_subscribed == 0) {
+		vrs_send_layer_subscribe(ctx->verse.session_id, VRS_DEFAULT_PRIORITY,
+				sender_node->node_id, sender_node->particle_layer_id, 0, 0);
+		sender_node->layer_subscribed = 1;
+		sender_node->layer_sync = LAYER_SYNC_WAIT;
+	}
+}
+
+/**
+ * \brief This function subscribes layers of senders, which entered interest
+ * of camera, and it unsubscribes layers of senders, which left interest of
+ * camera. It has to be called from thread calling Verse callbacks.
+ */
+void update_interest(struct Client_CTX *ctx)
+{
+	struct ParticleSenderNode *sender_node;
+	struct Particle_Sender *sender;
+	struct IngestRecord record;
+	struct Camera camera;
+	real32 aspect, sphere_radius;
+	int in_interest;
+
+	if(interest_is_enabled(ctx) == 0 || ctx->verse.particle_scene_node == NULL) {
+		return;
+	}
+
+	/* Camera is changed by display thread. It is copied without locking,
+	 * because inconsistent copy is corrected at next frame. */
+	camera = ctx->display->camera;
+	aspect = (ctx->display->window.height > 0) ?
+			(real32)ctx->display->window.width/ctx->display->window.height : 1.0;
+
+	for(sender_node = ctx->verse.particle_scene_node->senders.first;
+			sender_node != NULL;
+			sender_node = sender_node->next)
+	{
+		sender = sender_node->sender;
+		if(sender == NULL || sender_node->particle_layer_id == (uint16)-1) {
+			continue;
+		}
+
+		/* Senders in interest have to leave it with margin */
+		sphere_radius = ctx->pd->radius;
+		if(sender_node->layer_subscribed == 1) {
+			sphere_radius += INTEREST_MARGIN;
+		}
+
+		in_interest = (ctx->interest_radius > 0.0 &&
+				interest_in_radius(&camera, sender->pos, sphere_radius, ctx->interest_radius)) ||
+				(ctx->interest_frustum == 1 &&
+				interest_in_frustum(&camera, aspect, sender->pos, sphere_radius));
+
+		if(in_interest == 1 && sender_node->layer_subscribed == 0) {
+			/* Forget states received before sender left interest */
+			record.type = INGEST_RESET;
+			record.item_id = 0;
+			record.frame = 0;
+			record.time = 0;
+			ingest_push(sender->rec_pd, &record);
+
+			vrs_send_layer_subscribe(ctx->verse.session_id, VRS_DEFAULT_PRIORITY,
+					sender_node->node_id, sender_node->particle_layer_id, 0, 0);
+			sender_node->layer_subscribed = 1;
+			sender_node->layer_sync = LAYER_SYNC_WAIT;
+		} else if(in_interest == 0 && sender_node->layer_subscribed == 1) {
+			vrs_send_layer_unsubscribe(ctx->verse.session_id, VRS_DEFAULT_PRIORITY,
+					sender_node->node_id, sender_node->particle_layer_id, 0);
+			sender_node->layer_subscribed = 0;
+			sender_node->layer_sync = LAYER_SYNC_NONE;
+		}
+
+		/* Sender is in interest, when its layer is subscribed. It is stored
+		 * at every pass, because sender could be bound to new sender node */
+		__atomic_store_n(&sender->interest, sender_node->layer_subscribed, __ATOMIC_RELAXED);
+	}
+}
@@ -0,0 +1,242 @@
+/*
+ * $Id$
+ *
+ * ***** BEGIN BSD LICENSE BLOCK *****
+ *
+ * Copyright (c) 2009-2011, Jiri Hnidek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ***** END BSD LICENSE BLOCK *****
+ *
+ * Authors: Jiri Hnidek <jiri.hnidek@tul.cz>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "jitter_buffer.h"
+#include "particle_data.h"
+
+/**
+ * \brief This function initializes jitter buffer. Depth 0 creates disabled
+ * jitter buffer. When buffer is adaptive, then depth is maximal depth.
+ */
+int create_jitter_buffer(struct JitterBuffer *jb,
+		const uint16 particle_count,
+		const uint8 depth,
+		const uint8 adaptive)
+{
+	int i;
+
+	jb->depth = (depth < MAX_JITTER_DEPTH) ? depth : MAX_JITTER_DEPTH;
+	jb->max_depth = jb->depth;
+	jb->adaptive = adaptive;
+	jb->slot_count = 0;
+	jb->slot_size = particle_count;
+	jb->slot_frames = NULL;
+	jb->slot_counts = NULL;
+	jb->entries = NULL;
+	jb->occupancy = 0;
+	jb->released_frame = -1;
+	jb->last_transit = 0;
+	jb->jitter = 0;
+
+	if(jb->depth == 0) {
+		return 1;
+	}
+
+	/* Adaptive buffer starts with the lowest depth */
+	if(jb->adaptive == 1) {
+		jb->depth = 1;
+	}
+
+	/* One slot for each frame waiting in buffer and one for frame received
+	 * ahead of time */
+	jb->slot_count = jb->max_depth + 2;
+	jb->slot_frames = (int16*)malloc(jb->slot_count*sizeof(int16));
+	jb->slot_counts = (uint16*)calloc(jb->slot_count, sizeof(uint16));
+	jb->entries = (struct JitterEntry*)malloc((size_t)jb->slot_count*jb->slot_size*sizeof(struct JitterEntry));
+
+	if(jb->slot_frames == NULL || jb->slot_counts == NULL || jb->entries == NULL) {
+		free_jitter_buffer(jb);
+		jb->depth = 0;
+		return 0;
+	}
+
+	for(i=0; i<jb->slot_count; i++) {
+		jb->slot_frames[i] = -1;
+	}
+
+	return 1;
+}
+
+/**
+ * \brief This function frees arrays of jitter buffer
+ */
+void free_jitter_buffer(struct JitterBuffer *jb)
+{
+	if(jb->slot_frames != NULL) {
+		free(jb->slot_frames);
+		jb->slot_frames = NULL;
+	}
+	if(jb->slot_counts != NULL) {
+		free(jb->slot_counts);
+		jb->slot_counts = NULL;
+	}
+	if(jb->entries != NULL) {
+		free(jb->entries);
+		jb->entries = NULL;
+	}
+}
+
+/**
+ * \brief This function drops all states waiting in jitter buffer. It is used
+ * at the beginning of new animation loop.
+ */
+void clear_jitter_buffer(struct JitterBuffer *jb)
+{
+	int i;
+
+	for(i=0; i<jb->slot_count; i++) {
+		jb->slot_frames[i] = -1;
+		jb->slot_counts[i] = 0;
+	}
+
+	jb->occupancy = 0;
+	jb->released_frame = -1;
+}
+
+/**
+ * \brief This function updates estimation of jitter (RFC 3550 style) from
+ * transit time of received state
+ */
+static void jitter_buffer_estimate(struct JitterBuffer *jb,
+		const int32 transit)
+{
+	int32 diff = transit - jb->last_transit;
+
+	if(diff < 0) {
+		diff = -diff;
+	}
+
+	/* J = J + (|D| - J)/16, jitter is stored in 1/16 of frame */
+	jb->jitter += diff - ((jb->jitter + 8) >> 4);
+	jb->last_transit = transit;
+}
+
+/**
+ * \brief This function adds received state to the jitter buffer. State of
+ * frame, which was already released is dropped as late. State, which can't be
+ * stored in buffer, is applied immediately.
+ */
+void jitter_buffer_push(struct ReceivedParticleData *rpd,
+		const uint16 item_id,
+		const int16 ref_frame,
+		const int16 arrival_frame)
+{
+	struct JitterBuffer *jb = &rpd->jitter;
+	struct JitterEntry *entry;
+	int slot;
+
+	jitter_buffer_estimate(jb, arrival_frame - ref_frame);
+
+	/* Frame of this state was already released */
+	if(ref_frame <= jb->released_frame) {
+		__atomic_add_fetch(&rpd->stats.jitter_late_drops, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	slot = ref_frame % jb->slot_count;
+
+	/* Slot is used by other frame or it is full */
+	if((jb->slot_frames[slot] != -1 && jb->slot_frames[slot] != ref_frame) ||
+			jb->slot_counts[slot] >= jb->slot_size) {
+		__atomic_add_fetch(&rpd->stats.jitter_overflows, 1, __ATOMIC_RELAXED);
+		update_received_particle_state(rpd, item_id, ref_frame, arrival_frame, 0);
+		return;
+	}
+
+	entry = &jb->entries[slot*jb->slot_size + jb->slot_counts[slot]];
+	entry->item_id = item_id;
+	entry->arrival_frame = arrival_frame;
+
+	jb->slot_frames[slot] = ref_frame;
+	jb->slot_counts[slot]++;
+	jb->occupancy++;
+}
+
+/**
+ * \brief This function releases all states of frames, which are older then
+ * current frame - depth, in frame order. It is called at frame boundaries.
+ */
+void jitter_buffer_release(struct ReceivedParticleData *rpd,
+		const int16 current_frame)
+{
+	struct JitterBuffer *jb = &rpd->jitter;
+	struct JitterEntry *entry;
+	int i, slot, limit;
+
+	stats_hist_add(&rpd->stats.jitter_occupancy, jb->occupancy);
+
+	/* Depth of adaptive buffer is twice estimated jitter rounded up */
+	if(jb->adaptive == 1) {
+		jb->depth = (2*jb->jitter + 15) >> 4;
+		if(jb->depth < 1) {
+			jb->depth = 1;
+		} else if(jb->depth > jb->max_depth) {
+			jb->depth = jb->max_depth;
+		}
+	}
+	__atomic_store_n(&rpd->stats.jitter_depth, jb->depth, __ATOMIC_RELAXED);
+
+	limit = current_frame - jb->depth;
+
+	while(jb->occupancy > 0) {
+		/* Find the oldest frame in buffer */
+		slot = -1;
+		for(i=0; i<jb->slot_count; i++) {
+			if(jb->slot_frames[i] != -1 &&
+					(slot == -1 || jb->slot_frames[i] < jb->slot_frames[slot])) {
+				slot = i;
+			}
+		}
+
+		if(slot == -1 || jb->slot_frames[slot] > limit) {
+			break;
+		}
+
+		for(i=0; i<jb->slot_counts[slot]; i++) {
+			entry = &jb->entries[slot*jb->slot_size + i];
+			update_received_particle_state(rpd, entry->item_id,
+					jb->slot_frames[slot], entry->arrival_frame, 1);
+		}
+
+		jb->released_frame = jb->slot_frames[slot];
+		jb->occupancy -= jb->slot_counts[slot];
+		jb->slot_counts[slot] = 0;
+		jb->slot_frames[slot] = -1;
+	}
+}
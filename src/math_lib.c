@@ -59,6 +59,32 @@ void spherical_to_cartesian(real32 spher[3], real32 cart[3])
 	cart[2] = spher[0] * cos(spher[1]);
 }
 
+/**
+ * \brief This function computes cross product of two vectors
+ */
+void vector_cross(real32 a[3], real32 b[3], real32 res[3])
+{
+	res[0] = a[1]*b[2] - a[2]*b[1];
+	res[1] = a[2]*b[0] - a[0]*b[2];
+	res[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+/**
+ * \brief This function normalizes vector and it returns its original length
+ */
+real32 vector_normalize(real32 vec[3])
+{
+	real32 len = sqrt(vec[0]*vec[0] + vec[1]*vec[1] + vec[2]*vec[2]);
+
+	if(len > 0.0) {
+		vec[0] /= len;
+		vec[1] /= len;
+		vec[2] /= len;
+	}
+
+	return len;
+}
+
 /*
  * Convert HSV values to RGB values
  *
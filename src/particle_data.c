@@ -36,6 +36,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <string.h>
 #include <dirent.h>
 #include <sys/types.h>
@@ -61,6 +62,11 @@ void free_ref_particle_data(struct RefParticleData *pd)
 
 	free(pd->particles);
 	pd->particles = NULL;
+
+	if(pd->active_counts != NULL) {
+		free(pd->active_counts);
+		pd->active_counts = NULL;
+	}
 }
 
 void print_ref_particle_data(struct RefParticleData *pd)
@@ -96,6 +102,7 @@ void print_ref_particle_data(struct RefParticleData *pd)
 static void post_process_ref_particle_data(struct RefParticleData *pd)
 {
 	int id, frame, particle_is_born, particle_is_dead;
+	real32 *pos, dist;
 
 	/* Set up states of particles */
 	for(id=0; id < pd->particle_count; id++) {
@@ -147,6 +154,32 @@ static void post_process_ref_particle_data(struct RefParticleData *pd)
 
 		}
 	}
+
+	/* Count particles sent at each frame */
+	pd->active_counts = (uint16*)calloc(pd->frame_count, sizeof(uint16));
+	if(pd->active_counts != NULL) {
+		for(frame=0; frame<pd->frame_count; frame++) {
+			for(id=0; id < pd->particle_count; id++) {
+				if(pd->particles[id].states[frame].state == PARTICLE_STATE_ACTIVE) {
+					pd->active_counts[frame]++;
+				}
+			}
+		}
+	}
+
+	/* Compute radius of sphere around sender bounding all active particles */
+	pd->radius = 0.0;
+	for(id=0; id < pd->particle_count; id++) {
+		for(frame=0; frame<pd->frame_count; frame++) {
+			if(pd->particles[id].states[frame].state == PARTICLE_STATE_ACTIVE) {
+				pos = pd->particles[id].states[frame].pos;
+				dist = sqrt(pos[0]*pos[0] + pos[1]*pos[1] + pos[2]*pos[2]);
+				if(dist > pd->radius) {
+					pd->radius = dist;
+				}
+			}
+		}
+	}
 }
 
 /**
@@ -222,6 +255,8 @@ struct RefParticleData *read_ref_particle_data(char *dir_name)
 
 	pd->particle_count = max_particle_count;
 	pd->frame_count = frame_count;
+	pd->active_counts = NULL;
+	pd->radius = 0.0;
 
 	printf("Debug: number of particles: %d, number of frames: %d\n", pd->particle_count, pd->frame_count);
 
@@ -379,45 +414,442 @@ void free_received_particle_data(struct ReceivedParticleData *rpd)
 {
 	int i;
 
-	pthread_mutex_destroy(&rpd->mutex);
+	free_jitter_buffer(&rpd->jitter);
 
-	if(rpd->received_particles != NULL) {
-		for(i=0; i<rpd->ref_particle_data->particle_count; i++) {
-			if(rpd->received_particles[i].received_states) {
-				free(rpd->received_particles[i].received_states);
-				rpd->received_particles[i].received_states = NULL;
-			}
+	for(i=0; i<RENDER_BUFFER_COUNT; i++) {
+		if(rpd->render[i].particles != NULL) {
+			free(rpd->render[i].particles);
+			rpd->render[i].particles = NULL;
 		}
+	}
+
+	if(rpd->ingest_ring != NULL) {
+		spsc_ring_free(rpd->ingest_ring);
+		free(rpd->ingest_ring);
+		rpd->ingest_ring = NULL;
+	}
+
+	if(rpd->sync_values != NULL) {
+		free(rpd->sync_values);
+		rpd->sync_values = NULL;
+	}
+
+	if(rpd->received_particles != NULL) {
 		free(rpd->received_particles);
 		rpd->received_particles = NULL;
 	}
+
+	if(rpd->states != NULL) {
+		free(rpd->states);
+		rpd->states = NULL;
+	}
+
+	if(rpd->row_gens != NULL) {
+		free(rpd->row_gens);
+		rpd->row_gens = NULL;
+	}
+
+	if(rpd->delays != NULL) {
+		free(rpd->delays);
+		rpd->delays = NULL;
+	}
+
+	if(rpd->frame_times != NULL) {
+		free(rpd->frame_times);
+		rpd->frame_times = NULL;
+	}
+}
+
+/**
+ * \brief This function sets received state of particle at frame in current
+ * generation. States of frame from older generation are cleared before first
+ * state of frame is set. It has to be called only by thread updating received
+ * particle data.
+ */
+void set_received_state(struct ReceivedParticleData *rpd,
+		const uint16 item_id,
+		const int16 frame,
+		const enum Received_State state)
+{
+	uint64 *row = &rpd->states[frame*rpd->row_words];
+	uint64 word;
+	int i, shift;
+
+	/* Lazy reset of states of this frame */
+	if(rpd->row_gens[frame] != rpd->generation) {
+		for(i=0; i<rpd->row_words; i++) {
+			__atomic_store_n(&row[i], 0, __ATOMIC_RELAXED);
+		}
+		__atomic_store_n(&rpd->row_gens[frame], rpd->generation, __ATOMIC_RELEASE);
+	}
+
+	shift = (item_id % STATES_PER_WORD)*RECEIVED_STATE_BITS;
+	word = row[item_id/STATES_PER_WORD];
+	word &= ~((uint64)RECEIVED_STATE_MASK << shift);
+	word |= (uint64)((state - RECEIVED_STATE_UNRECEIVED) & RECEIVED_STATE_MASK) << shift;
+	__atomic_store_n(&row[item_id/STATES_PER_WORD], word, __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief This function returns number of particles received at frame. It
+ * counts non-zero packed states with popcount of words.
+ */
+uint32 received_count_in_frame(struct ReceivedParticleData *rpd,
+		const uint16 generation,
+		const int16 frame)
+{
+	uint64 *row = &rpd->states[frame*rpd->row_words];
+	uint64 word;
+	uint32 count = 0;
+	int i;
+
+	if(__atomic_load_n(&rpd->row_gens[frame], __ATOMIC_ACQUIRE) != generation) {
+		return 0;
+	}
+
+	for(i=0; i<rpd->row_words; i++) {
+		word = __atomic_load_n(&row[i], __ATOMIC_RELAXED);
+		/* Any of two bits of state is set */
+		count += __builtin_popcountll((word | (word >> 1)) & RECEIVED_LOW_BITS);
+	}
+
+	return count;
 }
 
 /**
- * \brief This function reset received particle data
+ * \brief This function reset received particle data. Received states are not
+ * touched, new generation makes all of them unreceived. It has to be called
+ * only by ingest worker owning shard of received particle data.
  */
 void reset_received_particle_data(struct ReceivedParticleData *rpd)
 {
-	int i, j;
+	uint16 generation = rpd->generation + 1;
+	int i;
+
+	/* Frames of very old generation would be valid again after wrapping of
+	 * generation counter, so generations of all frames have to be cleared */
+	if(generation == 0) {
+		for(i=0; i < rpd->ref_particle_data->frame_count; i++) {
+			__atomic_store_n(&rpd->row_gens[i], 0, __ATOMIC_RELAXED);
+		}
+		generation = 1;
+	}
 
-	pthread_mutex_lock(&rpd->mutex);
+	__atomic_store_n(&rpd->generation, generation, __ATOMIC_RELAXED);
 
 	for(i=0; i < rpd->ref_particle_data->particle_count; i++) {
 		/* Set up initial values */
-		rpd->received_particles[i].first_received_state = NULL;
-		rpd->received_particles[i].last_received_state = NULL;
-		rpd->received_particles[i].current_received_state = NULL;
-
-		for(j=0; j < rpd->ref_particle_data->frame_count; j++) {
-			/* Set up initial values */
-			rpd->received_particles[i].received_states[j].received_frame = 0;
-			rpd->received_particles[i].received_states[j].delay = 0;
-			rpd->received_particles[i].received_states[j].state = RECEIVED_STATE_UNRECEIVED;
+		rpd->received_particles[i].first_frame = -1;
+		rpd->received_particles[i].last_frame = -1;
+		rpd->received_particles[i].current_frame = -1;
+	}
+
+	/* States of previous loop waiting in jitter buffer are not needed */
+	clear_jitter_buffer(&rpd->jitter);
+
+	/* Times of frames of previous loop */
+	memset(rpd->frame_times, 0, rpd->ref_particle_data->frame_count*sizeof(uint64));
+
+	/* Snapshot of layer belongs to previous loop */
+	rpd->sync_frame = -1;
+}
+
+/**
+ * \brief This function forgets received states of one particle. It has to be
+ * called only by ingest worker owning shard of received particle data.
+ */
+void unset_received_particle(struct ReceivedParticleData *rpd,
+		const uint16 item_id)
+{
+	struct ReceivedParticle *rec_particle;
+
+	if(item_id >= rpd->ref_particle_data->particle_count) {
+		return;
+	}
+
+	rec_particle = &rpd->received_particles[item_id];
+	rec_particle->first_frame = -1;
+	rec_particle->last_frame = -1;
+	rec_particle->current_frame = -1;
+}
+
+/**
+ * \brief This function updates received state of particle at reference frame,
+ * which was received at arrival frame. The buffered is 1, when state was
+ * released from jitter buffer. It has to be called only by ingest worker
+ * owning shard of received particle data.
+ */
+void update_received_particle_state(struct ReceivedParticleData *rpd,
+		const uint16 item_id,
+		const int16 ref_frame,
+		const int16 arrival_frame,
+		const uint8 buffered)
+{
+	struct ReceivedParticle *rec_particle;
+	enum Received_State state;
+	int16 delay, intime_delay;
+	int32 last_frame;
+
+	rec_particle = &rpd->received_particles[item_id];
+
+	/* The latest frame received before this state */
+	last_frame = rec_particle->last_frame;
+
+	/* Set up first, last and current received frame */
+	if(rec_particle->first_frame == -1) {
+		rec_particle->first_frame = ref_frame;
+		rec_particle->last_frame = ref_frame;
+	} else {
+		if(rec_particle->first_frame > ref_frame) {
+			rec_particle->first_frame = ref_frame;
+		}
+		if(rec_particle->last_frame < ref_frame) {
+			rec_particle->last_frame = ref_frame;
+		}
+	}
+
+	/* This state is the current received */
+	rec_particle->current_frame = ref_frame;
+
+	/* Set up delay of receiving */
+	delay = arrival_frame - ref_frame;
+
+	/* States released by jitter buffer were held until their frame, so they
+	 * are in time, when they arrived before end of buffering */
+	intime_delay = (buffered == 1) ? 1 + rpd->jitter.depth : 1;
+
+	if(delay > intime_delay) {
+		state = RECEIVED_STATE_DELAY;
+	} else if(delay >= 0) {
+		state = RECEIVED_STATE_INTIME;
+	} else {
+		state = RECEIVED_STATE_AHEAD;
+	}
+
+	/* Count only first reception of state in statistics */
+	if(get_received_state(rpd, rpd->generation, item_id, ref_frame) == RECEIVED_STATE_UNRECEIVED) {
+		receiver_stats_add_state(&rpd->stats, state, delay, last_frame, ref_frame);
+	}
+
+	rpd->delays[ref_frame*rpd->ref_particle_data->particle_count + item_id] = delay;
+
+	/* The state is read by renderer without locking */
+	set_received_state(rpd, item_id, ref_frame, state);
+}
+
+/**
+ * \brief This function finds reference state of received particle position
+ * and it updates received state of particle or it adds the state to jitter
+ * buffer. It has to be called only by ingest worker owning shard of received
+ * particle data. It returns 1, when reference state was found.
+ */
+int apply_received_particle_state(struct ReceivedParticleData *rpd,
+		const uint16 item_id,
+		const int16 current_frame,
+		const uint64 arrival_time,
+		const real32 pos[3])
+{
+	struct RefParticleData *pd = rpd->ref_particle_data;
+	struct RefParticleState *ref_state;
+	int64 send_time;
+
+	if(item_id >= pd->particle_count) {
+		return 0;
+	}
+
+	/* Find reference state, frame of sender could be still unknown */
+	ref_state = find_ref_particle_state(pd,
+			&pd->particles[item_id],
+			(rpd->rec_frame >= 0) ? rpd->rec_frame : 0,
+			pos);
+
+	/* Was reference state found? */
+	if(ref_state == NULL) {
+		return 0;
+	}
+
+	/* States of frames not newer than snapshot of layer could be received
+	 * after subscription only in the snapshot. They seed received data and
+	 * stale states of particles not active in snapshot frame are dropped. */
+	if(ref_state->frame <= rpd->sync_frame) {
+		if(ref_state->frame == rpd->sync_frame &&
+				ref_state->state == PARTICLE_STATE_ACTIVE) {
+			seed_received_particle_state(rpd, item_id, ref_state->frame);
+		}
+		return 1;
+	}
+
+	/* One-way delay is measured at arrival with estimated clock of sender */
+	if(__atomic_load_n(&rpd->clock.valid, __ATOMIC_ACQUIRE) == 1 &&
+			rpd->frame_times[ref_state->frame] != 0) {
+		send_time = (int64)rpd->frame_times[ref_state->frame] -
+				__atomic_load_n(&rpd->clock.offset, __ATOMIC_RELAXED);
+		if((int64)arrival_time >= send_time) {
+			receiver_stats_add_latency(&rpd->stats, arrival_time - send_time);
+		}
+	}
+
+	if(rpd->jitter.depth > 0) {
+		jitter_buffer_push(rpd, item_id, ref_state->frame, current_frame);
+	} else {
+		update_received_particle_state(rpd, item_id, ref_state->frame, current_frame, 0);
+	}
+
+	return 1;
+}
+
+/**
+ * \brief This function seeds received particle data with state of particle
+ * at frame of layer snapshot sent by server after subscription. State is
+ * stored as received in time and it is not added to statistics. It has to be
+ * called only by ingest worker owning shard of received particle data.
+ */
+void seed_received_particle_state(struct ReceivedParticleData *rpd,
+		const uint16 item_id,
+		const int16 frame)
+{
+	struct RefParticleData *pd = rpd->ref_particle_data;
+	struct ReceivedParticle *rec_particle;
+
+	rec_particle = &rpd->received_particles[item_id];
+
+	if(rec_particle->first_frame == -1 || rec_particle->first_frame > frame) {
+		rec_particle->first_frame = frame;
+	}
+	if(rec_particle->last_frame < frame) {
+		rec_particle->last_frame = frame;
+	}
+	rec_particle->current_frame = frame;
+
+	rpd->delays[frame*pd->particle_count + item_id] = 0;
+	set_received_state(rpd, item_id, frame, RECEIVED_STATE_INTIME);
+}
+
+/**
+ * \brief This function predicts position of received particle at frame. It
+ * uses received state of this frame, when it was received. Otherwise it
+ * interpolates between received states not further then horizon frames or it
+ * extrapolates the last received state with its velocity. Received states are
+ * read atomically, so it could be called without locking.
+ */
+int predict_received_particle(struct ReceivedParticleData *rpd,
+		const uint16 item_id,
+		const int16 frame,
+		const uint16 horizon,
+		real32 pos[3])
+{
+	struct ReceivedParticle *rec_particle = &rpd->received_particles[item_id];
+	struct RefParticle *ref_particle = rec_particle->ref_particle;
+	struct RefParticleState *prev_state = NULL, *next_state = NULL;
+	uint16 generation = get_received_generation(rpd);
+	int f, last, end_frame;
+	real32 t;
+
+	if(frame < ref_particle->born_frame ||
+			ref_particle->states[frame].state != PARTICLE_STATE_ACTIVE) {
+		return PREDICT_NONE;
+	}
+
+	if(get_received_state(rpd, generation, item_id, frame) != RECEIVED_STATE_UNRECEIVED) {
+		pos[0] = ref_particle->states[frame].pos[0];
+		pos[1] = ref_particle->states[frame].pos[1];
+		pos[2] = ref_particle->states[frame].pos[2];
+		return PREDICT_RECEIVED;
+	}
+
+	/* Find the closest received state before frame */
+	last = (frame - horizon > ref_particle->born_frame) ? frame - horizon : ref_particle->born_frame;
+	for(f = frame - 1; f >= last; f--) {
+		if(get_received_state(rpd, generation, item_id, f) != RECEIVED_STATE_UNRECEIVED) {
+			prev_state = &ref_particle->states[f];
+			break;
+		}
+	}
+
+	if(prev_state == NULL) {
+		return PREDICT_NONE;
+	}
+
+	/* Find the closest received state after frame */
+	end_frame = (ref_particle->die_frame > 0) ? ref_particle->die_frame : rpd->ref_particle_data->frame_count;
+	last = (frame + horizon < end_frame) ? frame + horizon : end_frame - 1;
+	for(f = frame + 1; f <= last; f++) {
+		if(get_received_state(rpd, generation, item_id, f) != RECEIVED_STATE_UNRECEIVED) {
+			next_state = &ref_particle->states[f];
+			break;
+		}
+	}
+
+	if(next_state != NULL) {
+		t = (real32)(frame - prev_state->frame) / (next_state->frame - prev_state->frame);
+		pos[0] = prev_state->pos[0] + t*(next_state->pos[0] - prev_state->pos[0]);
+		pos[1] = prev_state->pos[1] + t*(next_state->pos[1] - prev_state->pos[1]);
+		pos[2] = prev_state->pos[2] + t*(next_state->pos[2] - prev_state->pos[2]);
+		return PREDICT_INTERPOLATED;
+	}
+
+	t = (real32)(frame - prev_state->frame) / REF_PARTICLE_FPS;
+	pos[0] = prev_state->pos[0] + t*prev_state->vel[0];
+	pos[1] = prev_state->pos[1] + t*prev_state->vel[1];
+	pos[2] = prev_state->pos[2] + t*prev_state->vel[2];
+
+	return PREDICT_EXTRAPOLATED;
+}
+
+/**
+ * \brief This function copies received particle data to the back buffer and
+ * it swaps back buffer with middle buffer. It has to be called only by the
+ * thread updating received particle data.
+ */
+void publish_received_particle_data(struct ReceivedParticleData *rpd)
+{
+	struct RenderSnapshot *snapshot = &rpd->render[rpd->render_back];
+	struct ReceivedParticle *rec_particle;
+	int i;
+
+	if(snapshot->particles == NULL) {
+		return;
+	}
+
+	snapshot->rec_frame = rpd->rec_frame;
+
+	for(i=0; i<rpd->ref_particle_data->particle_count; i++) {
+		rec_particle = &rpd->received_particles[i];
+		snapshot->particles[i].cur_frame = rec_particle->current_frame;
+		snapshot->particles[i].last_frame = rec_particle->last_frame;
+		if(rec_particle->current_frame != -1) {
+			snapshot->particles[i].cur_state = get_received_state(rpd, rpd->generation,
+					i, rec_particle->current_frame);
+		} else {
+			snapshot->particles[i].cur_state = RECEIVED_STATE_UNRECEIVED;
 		}
 	}
-	pthread_mutex_unlock(&rpd->mutex);
+
+	/* Swap back and middle buffer and mark middle buffer as fresh */
+	rpd->render_back = __atomic_exchange_n(&rpd->render_middle,
+			rpd->render_back | RENDER_BUFFER_FRESH, __ATOMIC_ACQ_REL) & ~RENDER_BUFFER_FRESH;
 }
 
+/**
+ * \brief This function returns the most recently published snapshot of
+ * received particle data. It never blocks and it has to be called only by
+ * renderer. Snapshot is valid until next call of this function.
+ */
+struct RenderSnapshot *read_received_particle_data(struct ReceivedParticleData *rpd)
+{
+	/* Swap front and middle buffer, when new snapshot was published */
+	if(__atomic_load_n(&rpd->render_middle, __ATOMIC_ACQUIRE) & RENDER_BUFFER_FRESH) {
+		rpd->render_front = __atomic_exchange_n(&rpd->render_middle,
+				rpd->render_front, __ATOMIC_ACQ_REL) & ~RENDER_BUFFER_FRESH;
+	}
+
+	return &rpd->render[rpd->render_front];
+}
+
+/* Shards of received data. Shard is kept, when data are bound to other
+ * sender, so only one ingest worker consumes records of data. */
+static uint32 rec_pd_shards = 0;
+
 /**
  * \brief This function creates new structure for storing received particles positions
  */
@@ -430,35 +862,135 @@ struct ReceivedParticleData *create_received_particle_data(struct Client_CTX *ct
 	rpd = (struct ReceivedParticleData*)malloc(sizeof(struct ReceivedParticleData));
 
 	if(rpd != NULL) {
-		pthread_mutex_init(&rpd->mutex, NULL);
 		rpd->rec_frame = -1;
+		rpd->loop = -1;
+		rpd->generation = 1;
 		rpd->ref_particle_data = pd;
+		rpd->ingest_drops = 0;
+		rpd->shard = __atomic_fetch_add(&rec_pd_shards, 1, __ATOMIC_RELAXED);
+		receiver_stats_init(&rpd->stats);
+		rpd->binding = 0;
+		rpd->checked_frame = -1;
+		rpd->sync_frame = -1;
+		rpd->sync_count = 0;
+		clock_sync_init(&rpd->clock);
+		rpd->next = NULL;
+
+		/* Create optional jitter buffer */
+		if(create_jitter_buffer(&rpd->jitter, pd->particle_count,
+				ctx->jitter_depth, ctx->jitter_adaptive) != 1) {
+			printf("ERROR: unable to allocate jitter buffer\n");
+		}
+
+		/* Create snapshots for renderer */
+		rpd->render_back = 0;
+		rpd->render_middle = 1;
+		rpd->render_front = 2;
+		for(i=0; i<RENDER_BUFFER_COUNT; i++) {
+			rpd->render[i].rec_frame = -1;
+			rpd->render[i].particles = (struct RenderParticle*)malloc(pd->particle_count*sizeof(struct RenderParticle));
+			if(rpd->render[i].particles != NULL) {
+				for(j=0; j<pd->particle_count; j++) {
+					rpd->render[i].particles[j].cur_frame = -1;
+					rpd->render[i].particles[j].last_frame = -1;
+					rpd->render[i].particles[j].cur_state = RECEIVED_STATE_UNRECEIVED;
+				}
+			}
+		}
+
+		/* Create ring for records received in callbacks */
+		rpd->ingest_ring = spsc_ring_create(INGEST_RING_FRAMES*pd->particle_count,
+				sizeof(struct IngestRecord));
+
+		/* Create buffer of values waiting for marker of layer snapshot */
+		rpd->sync_max_count = INGEST_RING_FRAMES*pd->particle_count;
+		rpd->sync_values = (struct IngestRecord*)malloc(rpd->sync_max_count*sizeof(struct IngestRecord));
+		if(rpd->sync_values == NULL) {
+			rpd->sync_max_count = 0;
+		}
 
 		/* Create array of received particles */
 		rpd->received_particles = (struct ReceivedParticle *)calloc(pd->particle_count, sizeof(struct ReceivedParticle));
 		if(rpd->received_particles) {
 			/* Initialize each particle */
 			for(i=0; i<pd->particle_count; i++) {
-				rpd->received_particles[i].first_received_state = NULL;
-				rpd->received_particles[i].last_received_state = NULL;
-				rpd->received_particles[i].current_received_state = NULL;
+				rpd->received_particles[i].first_frame = -1;
+				rpd->received_particles[i].last_frame = -1;
+				rpd->received_particles[i].current_frame = -1;
 				rpd->received_particles[i].ref_particle = &pd->particles[i];
-				/* Create array of received particle states */
-				rpd->received_particles[i].received_states = (struct ReceivedParticleState*)calloc(pd->frame_count, sizeof(struct ReceivedParticleState));
-				if(rpd->received_particles[i].received_states != NULL) {
-					/* Initialize each state */
-					for(j=0; j<pd->frame_count; j++) {
-						/* Create reference */
-						rpd->received_particles[i].received_states[j].ref_particle_state = &pd->particles[i].states[j];
-						/* Set up initial values */
-						rpd->received_particles[i].received_states[j].received_frame = 0;
-						rpd->received_particles[i].received_states[j].delay = 0;
-						rpd->received_particles[i].received_states[j].state = RECEIVED_STATE_UNRECEIVED;
-					}
-				}
 			}
 		}
+
+		/* Create packed arrays of received states. Generation 0 of all frames
+		 * means, that no state was received yet. */
+		rpd->row_words = (pd->particle_count + STATES_PER_WORD - 1) / STATES_PER_WORD;
+		rpd->states = (uint64*)calloc((size_t)pd->frame_count*rpd->row_words, sizeof(uint64));
+		rpd->row_gens = (uint16*)calloc(pd->frame_count, sizeof(uint16));
+		rpd->delays = (int16*)calloc((size_t)pd->frame_count*pd->particle_count, sizeof(int16));
+		rpd->frame_times = (uint64*)calloc(pd->frame_count, sizeof(uint64));
 	}
 
 	return rpd;
 }
+
+/**
+ * \brief This function returns received particle data for sender node bound
+ * to sender. Data of destroyed sender node are reused, when there are any in
+ * the pool. Otherwise new data are allocated. It can be called only from
+ * thread calling Verse callbacks.
+ */
+struct ReceivedParticleData *acquire_received_particle_data(struct Client_CTX *ctx)
+{
+	struct ReceivedParticleData *rpd = ctx->rec_pd_pool;
+	struct IngestRecord record;
+
+	if(rpd != NULL) {
+		ctx->rec_pd_pool = rpd->next;
+		rpd->next = NULL;
+
+		/* Clock of new sender node is not known */
+		clock_sync_init(&rpd->clock);
+
+		/* Records of previous sender node can still wait in the ring, so data
+		 * and statistics are reset by ingest thread after these records */
+		record.type = INGEST_BIND;
+		record.item_id = 0;
+		record.frame = 0;
+		record.time = 0;
+		if(spsc_ring_push(rpd->ingest_ring, &record) == 0) {
+			printf("ERROR: unable to reset reused received particle data\n");
+		}
+	} else {
+		rpd = create_received_particle_data(ctx);
+	}
+
+	return rpd;
+}
+
+/**
+ * \brief This function returns received particle data of destroyed sender
+ * node to the pool. Data are not freed, because renderer or ingest thread
+ * could still read them. It can be called only from thread calling Verse
+ * callbacks.
+ */
+void release_received_particle_data(struct Client_CTX *ctx,
+		struct ReceivedParticleData *rpd)
+{
+	rpd->next = ctx->rec_pd_pool;
+	ctx->rec_pd_pool = rpd;
+}
+
+/**
+ * \brief This function frees all received particle data in the pool
+ */
+void free_received_particle_data_pool(struct Client_CTX *ctx)
+{
+	struct ReceivedParticleData *rpd;
+
+	while(ctx->rec_pd_pool != NULL) {
+		rpd = ctx->rec_pd_pool;
+		ctx->rec_pd_pool = rpd->next;
+		free_received_particle_data(rpd);
+		free(rpd);
+	}
+}
@@ -57,6 +57,13 @@ struct ParticleSenderNode *create_particle_sender_node(struct ParticleSceneNode
 		node->particle_frame_tag_id = -1;
 		node->pos_tag_id = -1;
 		node->sender_id_tag_id = -1;
+		node->loop_tag_id = -1;
+		node->frame_time_tag_id = -1;
+		node->particle_layer_id = -1;
+		node->time_req_layer_id = -1;
+		node->time_resp_layer_id = -1;
+		node->layer_subscribed = 0;
+		node->layer_sync = LAYER_SYNC_NONE;
 		node->scene = scene_node;
 		node->particles.first = NULL;
 		node->particles.last = NULL;
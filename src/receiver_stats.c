@@ -0,0 +1,774 @@
+/*
+ * $Id$
+ *
+ * ***** BEGIN BSD LICENSE BLOCK *****
+ *
+ * Copyright (c) 2009-2011, Jiri Hnidek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ***** END BSD LICENSE BLOCK *****
+ *
+ * Authors: Jiri Hnidek <jiri.hnidek@tul.cz>
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "receiver_stats.h"
+#include "particle_data.h"
+#include "client.h"
+#include "sender.h"
+#include "timer.h"
+
+/**
+ * \brief This function returns index of histogram bucket for the value.
+ * Values lower then HIST_SUB_BUCKET_COUNT have own bucket, higher values share
+ * HIST_SUB_BUCKET_COUNT linear buckets in each power of two.
+ */
+static uint32 stats_hist_index(const uint32 value)
+{
+	uint32 shift;
+
+	if(value < HIST_SUB_BUCKET_COUNT) {
+		return value;
+	}
+
+	shift = (31 - __builtin_clz(value)) - HIST_SUB_BUCKET_BITS;
+
+	return (shift + 1)*HIST_SUB_BUCKET_COUNT + ((value >> shift) & (HIST_SUB_BUCKET_COUNT - 1));
+}
+
+/**
+ * \brief This function returns the lowest value stored in bucket with index
+ */
+static uint32 stats_hist_low(const uint32 index)
+{
+	uint32 shift;
+
+	if(index < HIST_SUB_BUCKET_COUNT) {
+		return index;
+	}
+
+	shift = index/HIST_SUB_BUCKET_COUNT - 1;
+
+	return (HIST_SUB_BUCKET_COUNT + index%HIST_SUB_BUCKET_COUNT) << shift;
+}
+
+/**
+ * \brief This function returns the highest value stored in bucket with index
+ */
+static uint32 stats_hist_high(const uint32 index)
+{
+	if(index < HIST_SUB_BUCKET_COUNT) {
+		return index;
+	}
+
+	return stats_hist_low(index) + ((1u << (index/HIST_SUB_BUCKET_COUNT - 1)) - 1);
+}
+
+/**
+ * \brief This function adds value to histogram in constant time. Histogram
+ * has to be updated only by one thread.
+ */
+void stats_hist_add(struct StatsHistogram *hist, const uint32 value)
+{
+	__atomic_add_fetch(&hist->counts[stats_hist_index(value)], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&hist->total, 1, __ATOMIC_RELAXED);
+	if(value > hist->max) {
+		__atomic_store_n(&hist->max, value, __ATOMIC_RELAXED);
+	}
+}
+
+/**
+ * \brief This function copies histogram updated by other thread
+ */
+void stats_hist_copy(struct StatsHistogram *dst, struct StatsHistogram *src)
+{
+	int i;
+
+	dst->total = __atomic_load_n(&src->total, __ATOMIC_RELAXED);
+	dst->max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+	for(i=0; i<HIST_BUCKET_COUNT; i++) {
+		dst->counts[i] = __atomic_load_n(&src->counts[i], __ATOMIC_RELAXED);
+	}
+}
+
+/**
+ * \brief This function adds all values of src histogram to dst histogram
+ */
+void stats_hist_merge(struct StatsHistogram *dst, struct StatsHistogram *src)
+{
+	int i;
+
+	dst->total += src->total;
+	if(src->max > dst->max) {
+		dst->max = src->max;
+	}
+	for(i=0; i<HIST_BUCKET_COUNT; i++) {
+		dst->counts[i] += src->counts[i];
+	}
+}
+
+/**
+ * \brief This function computes histogram of values added between two copies
+ * of cumulative histogram
+ */
+void stats_hist_diff(struct StatsHistogram *dst,
+		const struct StatsHistogram *cur,
+		const struct StatsHistogram *prev)
+{
+	int i;
+
+	dst->total = cur->total - prev->total;
+	dst->max = 0;
+	for(i=0; i<HIST_BUCKET_COUNT; i++) {
+		dst->counts[i] = cur->counts[i] - prev->counts[i];
+		if(dst->counts[i] > 0) {
+			dst->max = stats_hist_high(i);
+		}
+	}
+
+	/* Maximum of interval is known only with precision of bucket */
+	if(dst->max > cur->max) {
+		dst->max = cur->max;
+	}
+}
+
+/**
+ * \brief This function returns value at given percentile (0.0 - 1.0) of
+ * histogram. The highest value of bucket is returned.
+ */
+uint32 stats_hist_percentile(struct StatsHistogram *hist, const real32 percentile)
+{
+	uint32 limit, sum = 0;
+	int i;
+
+	if(hist->total == 0) {
+		return 0;
+	}
+
+	limit = (uint32)(percentile * hist->total);
+	if(limit < 1) {
+		limit = 1;
+	}
+
+	for(i=0; i<HIST_BUCKET_COUNT; i++) {
+		sum += hist->counts[i];
+		if(sum >= limit) {
+			break;
+		}
+	}
+
+	if(i == HIST_BUCKET_COUNT || stats_hist_high(i) > hist->max) {
+		return hist->max;
+	}
+
+	return stats_hist_high(i);
+}
+
+/**
+ * \brief This function initializes statistics of received particles
+ */
+void receiver_stats_init(struct ReceiverStats *stats)
+{
+	memset(stats, 0, sizeof(struct ReceiverStats));
+	stats->last_tot_frame = -1;
+}
+
+/**
+ * \brief This function adds new received state (in time, delayed or ahead)
+ * with delay in frames to statistics. The last_frame is the latest frame of particle received
+ * before this state (-1, when no state was received in this loop). It is
+ * called only by ingest thread.
+ */
+void receiver_stats_add_state(struct ReceiverStats *stats,
+		const uint8 state,
+		const int16 delay,
+		const int32 last_frame,
+		const int32 frame)
+{
+	__atomic_add_fetch(&stats->received, 1, __ATOMIC_RELAXED);
+
+	if(state == RECEIVED_STATE_INTIME) {
+		__atomic_add_fetch(&stats->intime, 1, __ATOMIC_RELAXED);
+	} else if(state == RECEIVED_STATE_DELAY) {
+		__atomic_add_fetch(&stats->late, 1, __ATOMIC_RELAXED);
+	} else {
+		__atomic_add_fetch(&stats->ahead, 1, __ATOMIC_RELAXED);
+	}
+
+	if(delay >= 0) {
+		stats_hist_add(&stats->delay, delay);
+	} else {
+		stats_hist_add(&stats->ahead_hist, -delay);
+	}
+
+	if(last_frame != -1) {
+		if(frame > last_frame + 1) {
+			/* States between last and this frame were not received (yet) */
+			stats_hist_add(&stats->loss, frame - last_frame - 1);
+		} else if(frame < last_frame) {
+			/* State was received after newer state */
+			stats_hist_add(&stats->reorder, last_frame - frame);
+		}
+	}
+}
+
+/**
+ * \brief This function adds one-way delay of received state in microseconds
+ * to statistics. It is called only by ingest thread.
+ */
+void receiver_stats_add_latency(struct ReceiverStats *stats,
+		const uint64 latency)
+{
+	stats_hist_add(&stats->latency, (latency < 0xFFFFFFFF) ? (uint32)latency : 0xFFFFFFFF);
+}
+
+/**
+ * \brief This function adds states sent by sender at all frames up to
+ * tot_frame to the number of expected states. It is called only by ingest
+ * thread at frame boundaries.
+ */
+void receiver_stats_add_frames(struct ReceiverStats *stats,
+		struct RefParticleData *pd,
+		const int32 tot_frame)
+{
+	int32 frame;
+	uint32 expected = 0;
+
+	if(tot_frame < 0) {
+		return;
+	}
+
+	/* Animation was started right now */
+	if(stats->last_tot_frame == -1) {
+		stats->last_tot_frame = tot_frame - 1;
+	}
+
+	for(frame = stats->last_tot_frame + 1; frame <= tot_frame; frame++) {
+		expected += pd->active_counts[frame % (pd->frame_count - 1)];
+	}
+
+	if(tot_frame > stats->last_tot_frame) {
+		stats->last_tot_frame = tot_frame;
+	}
+
+	__atomic_add_fetch(&stats->expected, expected, __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief This function adds result of prediction of lost position and its
+ * distance from reference position. It is called only by ingest thread.
+ */
+void receiver_stats_add_prediction(struct ReceiverStats *stats,
+		const int result,
+		const real32 error)
+{
+	switch(result) {
+	case PREDICT_INTERPOLATED:
+		__atomic_add_fetch(&stats->interpolated, 1, __ATOMIC_RELAXED);
+		stats_hist_add(&stats->predict_error, (uint32)(1000*error));
+		break;
+	case PREDICT_EXTRAPOLATED:
+		__atomic_add_fetch(&stats->extrapolated, 1, __ATOMIC_RELAXED);
+		stats_hist_add(&stats->predict_error, (uint32)(1000*error));
+		break;
+	case PREDICT_NONE:
+		__atomic_add_fetch(&stats->unpredicted, 1, __ATOMIC_RELAXED);
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * \brief This function copies statistics updated by ingest thread
+ */
+void receiver_stats_copy(struct ReceiverStats *dst,
+		struct ReceiverStats *src)
+{
+	dst->expected = __atomic_load_n(&src->expected, __ATOMIC_RELAXED);
+	dst->received = __atomic_load_n(&src->received, __ATOMIC_RELAXED);
+	dst->intime = __atomic_load_n(&src->intime, __ATOMIC_RELAXED);
+	dst->late = __atomic_load_n(&src->late, __ATOMIC_RELAXED);
+	dst->ahead = __atomic_load_n(&src->ahead, __ATOMIC_RELAXED);
+	stats_hist_copy(&dst->delay, &src->delay);
+	stats_hist_copy(&dst->ahead_hist, &src->ahead_hist);
+	stats_hist_copy(&dst->loss, &src->loss);
+	stats_hist_copy(&dst->reorder, &src->reorder);
+	stats_hist_copy(&dst->jitter_occupancy, &src->jitter_occupancy);
+	dst->jitter_late_drops = __atomic_load_n(&src->jitter_late_drops, __ATOMIC_RELAXED);
+	dst->jitter_overflows = __atomic_load_n(&src->jitter_overflows, __ATOMIC_RELAXED);
+	dst->jitter_depth = __atomic_load_n(&src->jitter_depth, __ATOMIC_RELAXED);
+	stats_hist_copy(&dst->predict_error, &src->predict_error);
+	dst->interpolated = __atomic_load_n(&src->interpolated, __ATOMIC_RELAXED);
+	dst->extrapolated = __atomic_load_n(&src->extrapolated, __ATOMIC_RELAXED);
+	dst->unpredicted = __atomic_load_n(&src->unpredicted, __ATOMIC_RELAXED);
+	stats_hist_copy(&dst->latency, &src->latency);
+}
+
+/**
+ * \brief This function adds statistics of one sender to global statistics
+ */
+static void receiver_stats_merge(struct ReceiverStats *dst,
+		struct ReceiverStats *src)
+{
+	dst->expected += src->expected;
+	dst->received += src->received;
+	dst->intime += src->intime;
+	dst->late += src->late;
+	dst->ahead += src->ahead;
+	stats_hist_merge(&dst->delay, &src->delay);
+	stats_hist_merge(&dst->ahead_hist, &src->ahead_hist);
+	stats_hist_merge(&dst->loss, &src->loss);
+	stats_hist_merge(&dst->reorder, &src->reorder);
+	stats_hist_merge(&dst->jitter_occupancy, &src->jitter_occupancy);
+	dst->jitter_late_drops += src->jitter_late_drops;
+	dst->jitter_overflows += src->jitter_overflows;
+	if(src->jitter_depth > dst->jitter_depth) {
+		dst->jitter_depth = src->jitter_depth;
+	}
+	stats_hist_merge(&dst->predict_error, &src->predict_error);
+	dst->interpolated += src->interpolated;
+	dst->extrapolated += src->extrapolated;
+	dst->unpredicted += src->unpredicted;
+	stats_hist_merge(&dst->latency, &src->latency);
+	dst->drops += src->drops;
+}
+
+/**
+ * \brief This function prints statistics of one sender received during
+ * last interval. The fps is frame rate of timer including time scale.
+ */
+static void receiver_stats_print(struct Particle_Sender *sender,
+		struct ReceivedParticleData *rpd,
+		struct ReceiverStats *cur,
+		struct ReceiverStats *prev,
+		real32 fps)
+{
+	struct StatsHistogram delay, hist;
+	uint32 expected, received, p50, p90, p99;
+	real32 drift;
+
+	expected = cur->expected - prev->expected;
+	received = cur->received - prev->received;
+
+	/* Histogram of delays received in last interval */
+	stats_hist_diff(&delay, &cur->delay, &prev->delay);
+
+	p50 = stats_hist_percentile(&delay, 0.5);
+	p90 = stats_hist_percentile(&delay, 0.9);
+	p99 = stats_hist_percentile(&delay, 0.99);
+
+	printf("Sender %d: delivery %5.1f %% (%u/%u), delay p50/p90/p99: %u/%u/%u frames (%u/%u/%u ms), in time: %u, late: %u, ahead: %u, drops: %u\n",
+			sender->id,
+			(expected > 0) ? (100.0*received)/expected : 0.0,
+			received, expected,
+			p50, p90, p99,
+			(uint32)(1000*p50/fps), (uint32)(1000*p90/fps), (uint32)(1000*p99/fps),
+			cur->intime - prev->intime,
+			cur->late - prev->late,
+			cur->ahead - prev->ahead,
+			cur->drops - prev->drops);
+
+	if(rpd->jitter.max_depth > 0) {
+		stats_hist_diff(&hist, &cur->jitter_occupancy, &prev->jitter_occupancy);
+		printf("Sender %d: jitter buffer depth: %u frames, occupancy p50/max: %u/%u, late drops: %u, overflows: %u\n",
+				sender->id,
+				cur->jitter_depth,
+				stats_hist_percentile(&hist, 0.5),
+				hist.max,
+				cur->jitter_late_drops - prev->jitter_late_drops,
+				cur->jitter_overflows - prev->jitter_overflows);
+	}
+
+	/* One-way delay measured with synchronized clock */
+	if(__atomic_load_n(&rpd->clock.valid, __ATOMIC_ACQUIRE) == 1) {
+		stats_hist_diff(&hist, &cur->latency, &prev->latency);
+		__atomic_load(&rpd->clock.drift, &drift, __ATOMIC_RELAXED);
+		printf("Sender %d: one-way delay p50/p90/p99: %u/%u/%u us, clock offset: %lld us, rtt: %u us, drift: %.1f ppm\n",
+				sender->id,
+				stats_hist_percentile(&hist, 0.5),
+				stats_hist_percentile(&hist, 0.9),
+				stats_hist_percentile(&hist, 0.99),
+				(long long)__atomic_load_n(&rpd->clock.offset, __ATOMIC_RELAXED),
+				__atomic_load_n(&rpd->clock.rtt, __ATOMIC_RELAXED),
+				drift);
+	}
+
+	stats_hist_diff(&hist, &cur->predict_error, &prev->predict_error);
+	if(hist.total > 0 || cur->unpredicted > prev->unpredicted) {
+		printf("Sender %d: predicted lost positions: interpolated: %u, extrapolated: %u, unpredicted: %u, error p50/p99/max: %.3f/%.3f/%.3f\n",
+				sender->id,
+				cur->interpolated - prev->interpolated,
+				cur->extrapolated - prev->extrapolated,
+				cur->unpredicted - prev->unpredicted,
+				stats_hist_percentile(&hist, 0.5)/1000.0,
+				stats_hist_percentile(&hist, 0.99)/1000.0,
+				hist.max/1000.0);
+	}
+}
+
+/**
+ * \brief This function prints aggregated statistics of all senders of all
+ * Verse sessions received during last interval
+ */
+static void receiver_stats_print_sessions(struct Client_CTX *ctx,
+		struct ReceiverStats *cur,
+		struct ReceiverStats *prev)
+{
+	struct StatsHistogram delay, latency;
+	uint32 expected, received, connected = 0, p50, p90, p99;
+	real32 fps = ctx->verse.fps*ctx->time_scale;
+	int i;
+
+	for(i=0; i<ctx->session_count; i++) {
+		if(CLIENT_SESSION(ctx, i)->verse.connected == 1) {
+			connected++;
+		}
+	}
+
+	expected = cur->expected - prev->expected;
+	received = cur->received - prev->received;
+
+	stats_hist_diff(&delay, &cur->delay, &prev->delay);
+	stats_hist_diff(&latency, &cur->latency, &prev->latency);
+
+	p50 = stats_hist_percentile(&delay, 0.5);
+	p90 = stats_hist_percentile(&delay, 0.9);
+	p99 = stats_hist_percentile(&delay, 0.99);
+
+	printf("Sessions: %u/%u, delivery %5.1f %% (%u/%u), delay p50/p90/p99/max: %u/%u/%u/%u frames (%u/%u/%u ms), one-way p50/p99: %u/%u us, in time: %u, late: %u, ahead: %u\n",
+			connected, ctx->session_count,
+			(expected > 0) ? (100.0*received)/expected : 0.0,
+			received, expected,
+			p50, p90, p99, delay.max,
+			(uint32)(1000*p50/fps), (uint32)(1000*p90/fps), (uint32)(1000*p99/fps),
+			stats_hist_percentile(&latency, 0.5),
+			stats_hist_percentile(&latency, 0.99),
+			cur->intime - prev->intime,
+			cur->late - prev->late,
+			cur->ahead - prev->ahead);
+}
+
+/**
+ * \brief This function writes non-empty buckets of histogram as JSON array
+ */
+static void stats_hist_write_json(FILE *file, const char *name,
+		struct StatsHistogram *hist)
+{
+	int i, first = 1;
+
+	fprintf(file, "\"%s\":{\"total\":%u,\"max\":%u,\"buckets\":[",
+			name, hist->total, hist->max);
+	for(i=0; i<HIST_BUCKET_COUNT; i++) {
+		if(hist->counts[i] > 0) {
+			fprintf(file, "%s[%u,%u,%u]", (first == 1) ? "" : ",",
+					stats_hist_low(i), stats_hist_high(i), hist->counts[i]);
+			first = 0;
+		}
+	}
+	fprintf(file, "]}");
+}
+
+/**
+ * \brief This function writes statistics of one sender (or all senders) as
+ * JSON object
+ */
+static void receiver_stats_write_json(FILE *file, const int32 id,
+		struct ReceiverStats *stats)
+{
+	fprintf(file, "{\"sender\":");
+	if(id == -1) {
+		fprintf(file, "\"all\"");
+	} else {
+		fprintf(file, "%d", id);
+	}
+	fprintf(file, ",\"expected\":%u,\"received\":%u,\"intime\":%u,\"late\":%u,\"ahead\":%u,\"drops\":%u,",
+			stats->expected, stats->received, stats->intime, stats->late, stats->ahead, stats->drops);
+	stats_hist_write_json(file, "delay", &stats->delay);
+	fprintf(file, ",");
+	stats_hist_write_json(file, "ahead_frames", &stats->ahead_hist);
+	fprintf(file, ",");
+	stats_hist_write_json(file, "loss_burst", &stats->loss);
+	fprintf(file, ",");
+	stats_hist_write_json(file, "reorder", &stats->reorder);
+	fprintf(file, ",\"jitter_depth\":%u,\"jitter_late_drops\":%u,\"jitter_overflows\":%u,",
+			stats->jitter_depth, stats->jitter_late_drops, stats->jitter_overflows);
+	stats_hist_write_json(file, "jitter_occupancy", &stats->jitter_occupancy);
+	fprintf(file, ",\"interpolated\":%u,\"extrapolated\":%u,\"unpredicted\":%u,",
+			stats->interpolated, stats->extrapolated, stats->unpredicted);
+	stats_hist_write_json(file, "predict_error_milli", &stats->predict_error);
+	fprintf(file, ",");
+	stats_hist_write_json(file, "latency_usec", &stats->latency);
+	fprintf(file, "}");
+}
+
+/**
+ * \brief This function writes non-empty buckets of histogram as CSV rows
+ */
+static void stats_hist_write_csv(FILE *file, const real32 time,
+		const char *sender, const char *name, struct StatsHistogram *hist)
+{
+	int i;
+
+	for(i=0; i<HIST_BUCKET_COUNT; i++) {
+		if(hist->counts[i] > 0) {
+			fprintf(file, "%.3f,%s,%s,%u,%u,%u\n", time, sender, name,
+					stats_hist_low(i), stats_hist_high(i), hist->counts[i]);
+		}
+	}
+}
+
+/**
+ * \brief This function writes statistics of one sender (or all senders) as
+ * CSV rows. Counters have empty bucket bounds.
+ */
+static void receiver_stats_write_csv(FILE *file, const real32 time,
+		const int32 id, struct ReceiverStats *stats)
+{
+	char sender[16];
+
+	if(id == -1) {
+		strcpy(sender, "all");
+	} else {
+		snprintf(sender, sizeof(sender), "%d", id);
+	}
+
+	fprintf(file, "%.3f,%s,expected,,,%u\n", time, sender, stats->expected);
+	fprintf(file, "%.3f,%s,received,,,%u\n", time, sender, stats->received);
+	fprintf(file, "%.3f,%s,intime,,,%u\n", time, sender, stats->intime);
+	fprintf(file, "%.3f,%s,late,,,%u\n", time, sender, stats->late);
+	fprintf(file, "%.3f,%s,ahead,,,%u\n", time, sender, stats->ahead);
+	fprintf(file, "%.3f,%s,drops,,,%u\n", time, sender, stats->drops);
+	stats_hist_write_csv(file, time, sender, "delay", &stats->delay);
+	stats_hist_write_csv(file, time, sender, "ahead_frames", &stats->ahead_hist);
+	stats_hist_write_csv(file, time, sender, "loss_burst", &stats->loss);
+	stats_hist_write_csv(file, time, sender, "reorder", &stats->reorder);
+	fprintf(file, "%.3f,%s,jitter_depth,,,%u\n", time, sender, stats->jitter_depth);
+	fprintf(file, "%.3f,%s,jitter_late_drops,,,%u\n", time, sender, stats->jitter_late_drops);
+	fprintf(file, "%.3f,%s,jitter_overflows,,,%u\n", time, sender, stats->jitter_overflows);
+	stats_hist_write_csv(file, time, sender, "jitter_occupancy", &stats->jitter_occupancy);
+	fprintf(file, "%.3f,%s,interpolated,,,%u\n", time, sender, stats->interpolated);
+	fprintf(file, "%.3f,%s,extrapolated,,,%u\n", time, sender, stats->extrapolated);
+	fprintf(file, "%.3f,%s,unpredicted,,,%u\n", time, sender, stats->unpredicted);
+	stats_hist_write_csv(file, time, sender, "predict_error_milli", &stats->predict_error);
+	stats_hist_write_csv(file, time, sender, "latency_usec", &stats->latency);
+}
+
+/**
+ * \brief This function writes statistics of ticks of timer thread as JSON
+ * object
+ */
+static void timer_stats_write_json(FILE *file, struct TimerStats *stats)
+{
+	fprintf(file, "{\"ticks\":%u,\"missed\":%u,", stats->ticks, stats->missed);
+	stats_hist_write_json(file, "lateness_usec", &stats->lateness);
+	fprintf(file, "}");
+}
+
+/**
+ * \brief This function writes statistics of ticks of timer thread as CSV rows
+ */
+static void timer_stats_write_csv(FILE *file, const real32 time,
+		struct TimerStats *stats)
+{
+	fprintf(file, "%.3f,timer,ticks,,,%u\n", time, stats->ticks);
+	fprintf(file, "%.3f,timer,missed,,,%u\n", time, stats->missed);
+	stats_hist_write_csv(file, time, "timer", "lateness_usec", &stats->lateness);
+}
+
+/**
+ * \brief This function copies statistics of received data with binding to
+ * sender node. It returns 0, when statistics were reset by ingest thread
+ * during copying.
+ */
+static int receiver_stats_read(struct ReceivedParticleData *rpd,
+		struct ReceiverStats *dst,
+		uint32 *binding)
+{
+	*binding = __atomic_load_n(&rpd->binding, __ATOMIC_ACQUIRE);
+	if(*binding & 1) {
+		return 0;
+	}
+
+	receiver_stats_copy(dst, &rpd->stats);
+	dst->drops = __atomic_load_n(&rpd->ingest_drops, __ATOMIC_RELAXED);
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&rpd->binding, __ATOMIC_RELAXED) == *binding;
+}
+
+/* Ticks of timer driving printing and exporting of statistics */
+static struct TickConsumer stats_ticks;
+
+/**
+ * \brief Main loop of statistics. Statistics of all senders are printed
+ * periodically by headless receiver and they are exported to the file, when
+ * name of file is set. Exported statistics are cumulative: one JSON object
+ * per line or CSV rows, when file name ends with ".csv".
+ */
+void *receiver_stats_loop(void *arg)
+{
+	struct Client_CTX *ctx = (struct Client_CTX*)arg;
+	struct Client_CTX *session;
+	struct Particle_Sender *sender;
+	struct ReceivedParticleData *rpd;
+	struct ReceiverStats *cur_stats, *prev_stats, *all_stats, *prev_all_stats;
+	struct ReceivedParticleData **bound_rpds;
+	uint32 *bound_bindings, binding;
+	FILE *file = NULL;
+	uint64 start_time;
+	struct TimerStats timer_stats;
+	real32 time;
+	uint32 count = ctx->session_count * ctx->sender_count;
+	uint32 interval, frames;
+	int i, j, csv = 0, len;
+
+	/* Senders of all sessions are numbered consecutively */
+	cur_stats = (struct ReceiverStats*)calloc(count + 1, sizeof(struct ReceiverStats));
+	prev_stats = (struct ReceiverStats*)calloc(count + 1, sizeof(struct ReceiverStats));
+	/* Received data and their binding, when previous statistics were taken */
+	bound_rpds = (struct ReceivedParticleData**)calloc(count, sizeof(struct ReceivedParticleData*));
+	bound_bindings = (uint32*)calloc(count, sizeof(uint32));
+	if(cur_stats == NULL || prev_stats == NULL || bound_rpds == NULL || bound_bindings == NULL) {
+		printf("ERROR: unable to allocate statistics of senders\n");
+		free(cur_stats);
+		free(prev_stats);
+		free(bound_rpds);
+		free(bound_bindings);
+		return NULL;
+	}
+	all_stats = &cur_stats[count];
+	prev_all_stats = &prev_stats[count];
+
+	if(ctx->stats_file != NULL) {
+		if((file = fopen(ctx->stats_file, "w")) == NULL) {
+			printf("ERROR: unable to open file: %s\n", ctx->stats_file);
+		} else {
+			len = strlen(ctx->stats_file);
+			if(len > 4 && strcmp(&ctx->stats_file[len-4], ".csv") == 0) {
+				csv = 1;
+				fprintf(file, "time,sender,metric,low,high,count\n");
+			}
+		}
+	}
+
+	start_time = timer_get_usec();
+
+	/* Statistics are taken at frame boundary once per interval */
+	tick_consumer_init(&stats_ticks, "stats");
+	interval = (uint32)(STATS_INTERVAL*ctx->verse.fps*ctx->time_scale);
+	if(interval < 1) {
+		interval = 1;
+	}
+
+	while(1) {
+		for(frames = 0; frames < interval; ) {
+			frames += tick_consumer_wait(&stats_ticks);
+		}
+
+		time = (timer_get_usec() - start_time) / 1000000.0;
+		memset(all_stats, 0, sizeof(struct ReceiverStats));
+		memset(prev_all_stats, 0, sizeof(struct ReceiverStats));
+
+		for(j=0; j<ctx->session_count; j++) {
+			session = CLIENT_SESSION(ctx, j);
+			for(sender = session->senders.first, i = j*ctx->sender_count;
+					sender != NULL && i < (int)((j+1)*ctx->sender_count);
+					sender = sender->next, i++)
+			{
+				if((rpd = __atomic_load_n(&sender->rec_pd, __ATOMIC_ACQUIRE)) == NULL) {
+					continue;
+				}
+				if(receiver_stats_read(rpd, &cur_stats[i], &binding) == 1) {
+					/* Statistics of new sender node start from zero */
+					if(rpd != bound_rpds[i] || binding != bound_bindings[i]) {
+						receiver_stats_init(&prev_stats[i]);
+						bound_rpds[i] = rpd;
+						bound_bindings[i] = binding;
+					}
+				} else {
+					/* Statistics are being reset, nothing changed in interval */
+					cur_stats[i] = prev_stats[i];
+				}
+				receiver_stats_merge(all_stats, &cur_stats[i]);
+				receiver_stats_merge(prev_all_stats, &prev_stats[i]);
+				/* Statistics of more sessions are printed only aggregated */
+				if((ctx->flags & VC_HEADLESS) && ctx->session_count == 1) {
+					receiver_stats_print(sender, rpd, &cur_stats[i], &prev_stats[i],
+							ctx->verse.fps*ctx->time_scale);
+				}
+				prev_stats[i] = cur_stats[i];
+			}
+		}
+
+		if((ctx->flags & VC_HEADLESS) && ctx->session_count > 1) {
+			receiver_stats_print_sessions(ctx, all_stats, prev_all_stats);
+		}
+		/* Ticks of timer are reported also with display */
+		timer_stats_print();
+
+		if(file != NULL) {
+			if(csv == 1) {
+				for(i=0; i<(int)count; i++) {
+					receiver_stats_write_csv(file, time, i, &cur_stats[i]);
+				}
+				receiver_stats_write_csv(file, time, -1, all_stats);
+				timer_stats_read(&timer_stats);
+				timer_stats_write_csv(file, time, &timer_stats);
+			} else {
+				fprintf(file, "{\"time\":%.3f,\"senders\":[", time);
+				for(i=0; i<(int)count; i++) {
+					if(i > 0) {
+						fprintf(file, ",");
+					}
+					receiver_stats_write_json(file, i, &cur_stats[i]);
+				}
+				fprintf(file, "],\"global\":");
+				receiver_stats_write_json(file, -1, all_stats);
+				fprintf(file, ",\"timer\":");
+				timer_stats_read(&timer_stats);
+				timer_stats_write_json(file, &timer_stats);
+				fprintf(file, "}\n");
+			}
+			fflush(file);
+		}
+	}
+
+	if(file != NULL) {
+		fclose(file);
+	}
+	free(cur_stats);
+	free(prev_stats);
+	free(bound_rpds);
+	free(bound_bindings);
+
+	return NULL;
+}
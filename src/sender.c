@@ -45,9 +45,13 @@
 #include "particle_data.h"
 
 /**
- * \brief This function create sender structure
+ * \brief This function create sender structure. Items set on server are
+ * tracked only for item_count greater than zero.
  */
-static struct Particle_Sender *create_particle_sender(real32 pos[3], uint16 id)
+static struct Particle_Sender *create_particle_sender(real32 pos[3],
+		uint16 id,
+		uint16 frame_count,
+		uint16 item_count)
 {
 	struct Particle_Sender *sender = NULL;
 
@@ -58,39 +62,50 @@ static struct Particle_Sender *create_particle_sender(real32 pos[3], uint16 id)
 		sender->pos[1] = pos[1];
 		sender->pos[2] = pos[2];
 		sender->id = id;
+		sender->sent_cmd_count = 0;
+		sender->attached = 0;
+		sender->loop = -1;
+		sender->set_items = NULL;
+		if(item_count > 0) {
+			sender->set_items = (uint8*)calloc(item_count, sizeof(uint8));
+			if(sender->set_items == NULL) {
+				printf("ERROR: unable to allocate items of sender\n");
+			}
+		}
 
 		sender->sender_node = NULL;
 
-		sender->timer = create_timer();
+		sender->timer = create_timer(frame_count);
 
 		sender->rec_pd = NULL;
+		sender->display_particles = NULL;
+		sender->interest = 1;
 	}
 
 	return sender;
 }
 
 /**
- * \brief This function create linked list of senders in client ctx
+ * \brief This function create linked list of senders in client ctx. Senders
+ * are placed on square grid.
  */
 void create_senders(struct Client_CTX *ctx)
 {
 	struct Particle_Sender *sender;
-	int i, j, id = 0, side = sqrt(ctx->sender_count);
+	int i, j, id = 0, side = ceil(sqrt(ctx->sender_count));
+	uint16 frame_count = (ctx->pd != NULL) ? ctx->pd->frame_count : 0;
+	uint16 item_count = (ctx->pd != NULL && ctx->client_type == CLIENT_SENDER) ?
+			ctx->pd->particle_count : 0;
 	real32 pos[3];
 
 	for(i=0; i<side; i++) {
-		for(j=0; j<side; j++) {
+		for(j=0; j<side && id<(int)ctx->sender_count; j++) {
 			pos[0] = 0.0 - 40.0*i;
 			pos[1] = 0.0 + 40.0*j;
 			pos[2] = 0.0;
-			sender = create_particle_sender(pos, id);
-			if(sender != NULL) {
-				if(ctx->client_type == CLIENT_RECEIVER) {
-					sender->rec_pd = create_received_particle_data(ctx);
-				} else {
-					sender->rec_pd = NULL;
-				}
-			}
+			/* Received particle data are allocated, when sender node is
+			 * bound to the sender */
+			sender = create_particle_sender(pos, id, frame_count, item_count);
 			id++;
 
 			v_list_add_tail(&ctx->senders, sender);
@@ -0,0 +1,134 @@
+/*
+ * $Id$
+ *
+ * ***** BEGIN BSD LICENSE BLOCK *****
+ *
+ * Copyright (c) 2009-2011, Jiri Hnidek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ***** END BSD LICENSE BLOCK *****
+ *
+ * Authors: Jiri Hnidek <jiri.hnidek@tul.cz>
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "spsc_ring.h"
+
+/**
+ * \brief This function creates new ring buffer. Capacity is rounded up to
+ * the power of two.
+ */
+struct SPSC_Ring *spsc_ring_create(uint32 capacity, uint16 item_size)
+{
+	struct SPSC_Ring *ring;
+	uint32 size = 1;
+
+	while(size < capacity) {
+		size <<= 1;
+	}
+
+	ring = (struct SPSC_Ring*)malloc(sizeof(struct SPSC_Ring));
+
+	if(ring != NULL) {
+		ring->head = 0;
+		ring->tail = 0;
+		ring->size = size;
+		ring->mask = size - 1;
+		ring->item_size = item_size;
+		ring->items = (uint8*)malloc((size_t)size*item_size);
+		if(ring->items == NULL) {
+			free(ring);
+			ring = NULL;
+		}
+	}
+
+	return ring;
+}
+
+/**
+ * \brief This function free array of items in ring buffer
+ */
+void spsc_ring_free(struct SPSC_Ring *ring)
+{
+	if(ring->items != NULL) {
+		free(ring->items);
+		ring->items = NULL;
+	}
+}
+
+/**
+ * \brief This function copies item to the ring. It can be called only by
+ * producer thread. It returns 1, when item was added and 0, when ring is full.
+ */
+int spsc_ring_push(struct SPSC_Ring *ring, const void *item)
+{
+	uint32 head = ring->head;
+	uint32 tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	if(head - tail >= ring->size) {
+		return 0;
+	}
+
+	memcpy(&ring->items[(size_t)(head & ring->mask)*ring->item_size], item, ring->item_size);
+
+	/* Make item visible to consumer */
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+/**
+ * \brief This function copies the oldest item from the ring. It can be called
+ * only by consumer thread. It returns 1, when item was read and 0, when ring
+ * is empty.
+ */
+int spsc_ring_pop(struct SPSC_Ring *ring, void *item)
+{
+	uint32 tail = ring->tail;
+	uint32 head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+	if(head == tail) {
+		return 0;
+	}
+
+	memcpy(item, &ring->items[(size_t)(tail & ring->mask)*ring->item_size], ring->item_size);
+
+	/* Give slot back to producer */
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+/**
+ * \brief This function returns number of items in the ring
+ */
+uint32 spsc_ring_count(struct SPSC_Ring *ring)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) -
+			__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
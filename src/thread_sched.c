@@ -0,0 +1,126 @@
+/*
+ * $Id$
+ *
+ * ***** BEGIN BSD LICENSE BLOCK *****
+ *
+ * Copyright (c) 2009-2011, Jiri Hnidek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ***** END BSD LICENSE BLOCK *****
+ *
+ * Authors: Jiri Hnidek <jiri.hnidek@tul.cz>
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "thread_sched.h"
+
+/**
+ * \brief This function parses list of CPUs (e.g.: "0,2-3") to CPU set. It
+ * returns 1, when list is valid.
+ */
+static int thread_sched_parse_cpus(const char *cpus, cpu_set_t *set)
+{
+	const char *str = cpus;
+	char *end;
+	long first, last, cpu;
+
+	CPU_ZERO(set);
+
+	while(*str != '\0') {
+		first = strtol(str, &end, 10);
+		if(end == str || first < 0 || first >= CPU_SETSIZE) {
+			return 0;
+		}
+		last = first;
+		str = end;
+
+		if(*str == '-') {
+			str++;
+			last = strtol(str, &end, 10);
+			if(end == str || last < first || last >= CPU_SETSIZE) {
+				return 0;
+			}
+			str = end;
+		}
+
+		for(cpu = first; cpu <= last; cpu++) {
+			CPU_SET(cpu, set);
+		}
+
+		if(*str == ',') {
+			str++;
+		} else if(*str != '\0') {
+			return 0;
+		}
+	}
+
+	return CPU_COUNT(set) > 0;
+}
+
+/**
+ * \brief This function returns 1, when list of CPUs is valid
+ */
+int thread_sched_check_cpus(const char *cpus)
+{
+	cpu_set_t set;
+
+	return thread_sched_parse_cpus(cpus, &set);
+}
+
+/**
+ * \brief This function pins calling thread to the list of CPUs (NULL: no
+ * pinning) and it switches thread to SCHED_FIFO with priority (0: default
+ * scheduling). When it is not possible (e.g. without privileges), then
+ * warning is printed and thread continues with default settings.
+ */
+void thread_sched_setup(const char *name, const char *cpus, const int priority)
+{
+	struct sched_param param;
+	cpu_set_t set;
+	int ret;
+
+	if(cpus != NULL && thread_sched_parse_cpus(cpus, &set) == 1) {
+		if((ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set)) != 0) {
+			printf("WARNING: unable to pin %s thread to CPUs %s: %s\n",
+					name, cpus, strerror(ret));
+		}
+	}
+
+	if(priority > 0) {
+		param.sched_priority = priority;
+		if((ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) != 0) {
+			printf("WARNING: unable to run %s thread with SCHED_FIFO priority %d: %s, default scheduling is used\n",
+					name, priority, strerror(ret));
+		}
+	}
+}
@@ -38,107 +38,389 @@
 #include <pthread.h>
 #include <sys/time.h>
 #include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include <verse.h>
 
 #include "timer.h"
 #include "client.h"
+#include "thread_sched.h"
 #include <stdio.h>
 
 static struct Client_CTX *ctx = NULL;
 
+/* Lateness of ticks and skipped frames */
+static struct TimerStats timer_stats;
+
+/* Global tick incremented by timer thread at each frame */
+static uint32 timer_tick = 0;
+
+/* Sequence number of tick broadcast. It is incremented once per wake-up of
+ * timer thread and consumers wait for its change on futex. */
+static uint32 tick_seq = 0;
+
+/* Time of the last tick (its deadline) in microseconds */
+static uint64 tick_time = 0;
+
+/* Registered consumers of ticks */
+static struct TickConsumer *tick_consumers[MAX_TICK_CONSUMERS];
+static uint32 tick_consumer_count = 0;
+
+/**
+ * \brief This function initializes consumer of ticks and registers it for
+ * printing of statistics. Consumer will wait for the next tick.
+ */
+void tick_consumer_init(struct TickConsumer *consumer, const char *name)
+{
+	uint32 index;
+
+	memset(consumer, 0, sizeof(struct TickConsumer));
+	consumer->name = name;
+	consumer->last_seq = __atomic_load_n(&tick_seq, __ATOMIC_ACQUIRE);
+	consumer->last_tick = __atomic_load_n(&timer_tick, __ATOMIC_ACQUIRE);
+
+	index = __atomic_fetch_add(&tick_consumer_count, 1, __ATOMIC_RELAXED);
+	if(index < MAX_TICK_CONSUMERS) {
+		__atomic_store_n(&tick_consumers[index], consumer, __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ * \brief This function updates consumer to tick sequence seq and it returns
+ * number of frames elapsed since last wake-up of consumer
+ */
+static uint32 tick_consumer_update(struct TickConsumer *consumer, uint32 seq)
+{
+	uint32 tick = __atomic_load_n(&timer_tick, __ATOMIC_ACQUIRE);
+	uint32 frames = tick - consumer->last_tick;
+	uint64 latency;
+
+	/* Latency between deadline of tick and wake-up of consumer. Ticks are
+	 * broadcasted only after ctx was set by timer thread. */
+	if(ctx->flags & VC_WAKEUP_LATENCY) {
+		latency = timer_get_usec() - __atomic_load_n(&tick_time, __ATOMIC_RELAXED);
+		stats_hist_add(&consumer->wakeup, (latency < 0xFFFFFFFF) ? (uint32)latency : 0xFFFFFFFF);
+	}
+
+	__atomic_add_fetch(&consumer->wakeups, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&consumer->coalesced, seq - consumer->last_seq - 1, __ATOMIC_RELAXED);
+	stats_hist_add(&consumer->lag, seq - consumer->last_seq - 1);
+
+	consumer->last_seq = seq;
+	consumer->last_tick = tick;
+
+	return frames;
+}
+
+/**
+ * \brief This function waits for the next tick. When consumer missed some
+ * ticks, then it returns immediately. It returns number of frames elapsed
+ * since last wake-up of consumer.
+ */
+uint32 tick_consumer_wait(struct TickConsumer *consumer)
+{
+	uint32 seq;
+
+	while((seq = __atomic_load_n(&tick_seq, __ATOMIC_ACQUIRE)) == consumer->last_seq) {
+		syscall(SYS_futex, &tick_seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+	}
+
+	return tick_consumer_update(consumer, seq);
+}
+
+/**
+ * \brief This function returns number of frames elapsed since last wake-up of
+ * consumer without waiting. It returns 0, when no tick was broadcasted.
+ */
+uint32 tick_consumer_poll(struct TickConsumer *consumer)
+{
+	uint32 seq = __atomic_load_n(&tick_seq, __ATOMIC_ACQUIRE);
+
+	if(seq == consumer->last_seq) {
+		return 0;
+	}
+
+	return tick_consumer_update(consumer, seq);
+}
+
+/**
+ * \brief This function wakes all consumers waiting for tick
+ */
+static void tick_broadcast(const uint64 time)
+{
+	__atomic_store_n(&tick_time, time, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&tick_seq, 1, __ATOMIC_RELEASE);
+	syscall(SYS_futex, &tick_seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
 /**
  * \brief This function creates and initialize new timer structure
  */
-struct Timer *create_timer(void)
+struct Timer *create_timer(const uint16 frame_count)
 {
 	struct Timer *timer;
 
 	timer = (struct Timer*)malloc(sizeof(struct Timer));
 
 	if(timer != NULL) {
-		timer->frame = -1;
-		timer->tot_frame = -1;
+		timer->frame_count = frame_count;
+		timer->start = 0;
 		timer->run = 0;
 		pthread_mutex_init(&timer->mutex, NULL);
+		timer_publish(timer);
 	}
 
 	return timer;
 }
 
 /**
- * \brief Main timer thread loop
+ * \brief This function publishes current values of timer to readers. It has
+ * to be called by writer with locked mutex of timer.
+ */
+void timer_publish(struct Timer *timer)
+{
+	uint64 snapshot;
+
+	snapshot = (uint64)timer->start | ((uint64)timer->run << 32);
+
+	__atomic_store_n(&timer->snapshot, snapshot, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief This function reads consistent snapshot of timer values without
+ * locking of mutex. Frame is computed from global tick.
+ */
+void timer_read(struct Timer *timer, struct TimerSnapshot *snapshot)
+{
+	uint64 value = __atomic_load_n(&timer->snapshot, __ATOMIC_ACQUIRE);
+	uint32 tick = __atomic_load_n(&timer_tick, __ATOMIC_ACQUIRE);
+
+	snapshot->run = (uint8)((value >> 32) & 0xFF);
+
+	if(snapshot->run == 0) {
+		snapshot->frame = -1;
+		snapshot->tot_frame = -1;
+		return;
+	}
+
+	snapshot->tot_frame = (int32)(tick - (uint32)(value & 0xFFFFFFFF));
+
+	/* Crop frame to be in limit:  <0, frame_count-1> */
+	if(snapshot->tot_frame < 0 || timer->frame_count < 2) {
+		snapshot->frame = 0;
+	} else {
+		snapshot->frame = (int16)(snapshot->tot_frame % (timer->frame_count - 1));
+	}
+}
+
+/**
+ * \brief This function starts timer at given total frame, when timer isn't
+ * running yet
+ */
+void timer_start(struct Timer *timer, int16 tot_frame)
+{
+	pthread_mutex_lock(&timer->mutex);
+	if(timer->run == 0) {
+		timer->run = 1;
+		timer->start = __atomic_load_n(&timer_tick, __ATOMIC_ACQUIRE) - (uint32)(int32)tot_frame;
+		timer_publish(timer);
+	}
+	pthread_mutex_unlock(&timer->mutex);
+}
+
+/**
+ * \brief This function stops timer, e.g. when sender node was destroyed
+ */
+void timer_stop(struct Timer *timer)
+{
+	pthread_mutex_lock(&timer->mutex);
+	timer->run = 0;
+	timer_publish(timer);
+	pthread_mutex_unlock(&timer->mutex);
+}
+
+/**
+ * \brief This function returns current time of monotonic clock in microseconds
+ */
+uint64 timer_get_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64)ts.tv_sec*ONE_SECOND + ts.tv_nsec/1000;
+}
+
+/**
+ * \brief This function adds nanoseconds to time
+ */
+static void timer_add_nsec(struct timespec *ts, const uint64 nsec)
+{
+	uint64 total = (uint64)ts->tv_nsec + nsec;
+
+	ts->tv_sec += total / ONE_SECOND_NSEC;
+	ts->tv_nsec = total % ONE_SECOND_NSEC;
+}
+
+/**
+ * \brief This function returns difference of two times in nanoseconds
+ */
+static int64 timer_diff_nsec(const struct timespec *a, const struct timespec *b)
+{
+	return (int64)(a->tv_sec - b->tv_sec)*ONE_SECOND_NSEC + (a->tv_nsec - b->tv_nsec);
+}
+
+/**
+ * \brief This function copies cumulative statistics of ticks of timer thread
+ */
+void timer_stats_read(struct TimerStats *stats)
+{
+	stats->ticks = __atomic_load_n(&timer_stats.ticks, __ATOMIC_RELAXED);
+	stats->missed = __atomic_load_n(&timer_stats.missed, __ATOMIC_RELAXED);
+	stats_hist_copy(&stats->lateness, &timer_stats.lateness);
+}
+
+/**
+ * \brief This function prints statistics of ticks and lag of consumers of
+ * ticks since last printing
+ */
+void timer_stats_print(void)
+{
+	static struct TimerStats prev;
+	struct TimerStats cur;
+	struct StatsHistogram lateness, lag, wakeup;
+	struct TickConsumer *consumer;
+	uint32 count, i, wakeups, coalesced;
+
+	timer_stats_read(&cur);
+
+	stats_hist_diff(&lateness, &cur.lateness, &prev.lateness);
+
+	printf("Timer: ticks: %u, missed frames: %u, lateness p50/p90/p99/max: %u/%u/%u/%u us\n",
+			cur.ticks - prev.ticks,
+			cur.missed - prev.missed,
+			stats_hist_percentile(&lateness, 0.5),
+			stats_hist_percentile(&lateness, 0.9),
+			stats_hist_percentile(&lateness, 0.99),
+			lateness.max);
+
+	prev = cur;
+
+	/* Lag of consumers of ticks */
+	count = __atomic_load_n(&tick_consumer_count, __ATOMIC_RELAXED);
+	for(i=0; i<count && i<MAX_TICK_CONSUMERS; i++) {
+		if((consumer = __atomic_load_n(&tick_consumers[i], __ATOMIC_ACQUIRE)) == NULL) {
+			continue;
+		}
+
+		wakeups = __atomic_load_n(&consumer->wakeups, __ATOMIC_RELAXED);
+		coalesced = __atomic_load_n(&consumer->coalesced, __ATOMIC_RELAXED);
+		stats_hist_copy(&lag, &consumer->lag);
+		stats_hist_diff(&lateness, &lag, &consumer->prev_lag);
+
+		printf("Timer consumer %s: wake-ups: %u, coalesced ticks: %u, lag p99/max: %u/%u ticks\n",
+				consumer->name,
+				wakeups - consumer->prev_wakeups,
+				coalesced - consumer->prev_coalesced,
+				stats_hist_percentile(&lateness, 0.99),
+				lag.max);
+
+		if(ctx->flags & VC_WAKEUP_LATENCY) {
+			stats_hist_copy(&wakeup, &consumer->wakeup);
+			stats_hist_diff(&lateness, &wakeup, &consumer->prev_wakeup);
+			printf("Timer consumer %s: wake-up latency p50/p90/p99/max: %u/%u/%u/%u us\n",
+					consumer->name,
+					stats_hist_percentile(&lateness, 0.5),
+					stats_hist_percentile(&lateness, 0.9),
+					stats_hist_percentile(&lateness, 0.99),
+					wakeup.max);
+			consumer->prev_wakeup = wakeup;
+		}
+
+		consumer->prev_wakeups = wakeups;
+		consumer->prev_coalesced = coalesced;
+		consumer->prev_lag = lag;
+	}
+}
+
+/**
+ * \brief Loop of timer with virtual clock. Next tick is started as soon as
+ * sender finished previous frame, so frames are never skipped and sequence
+ * of frames does not depend on load of machine.
+ */
+static void timer_virtual_loop(void)
+{
+	while(1) {
+		/* Wait, till sender requests next frame */
+		sem_wait(&ctx->frame_sem);
+
+		__atomic_add_fetch(&timer_stats.ticks, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&timer_tick, 1, __ATOMIC_RELEASE);
+
+		tick_broadcast(timer_get_usec());
+	}
+}
+
+/**
+ * \brief Main timer thread loop. Ticks are scheduled at absolute times of
+ * monotonic clock, so time spent by processing of tick does not shift next
+ * ticks. When tick is late more than one frame, then missed frames are
+ * skipped explicitly. Each tick only increments global tick, so it does not
+ * depend on number of senders.
  */
 void *timer_loop(void *arg)
 {
-	struct Particle_Sender *sender;
-	struct timeval	current_tv, first_tv, expected_tv;
-	unsigned long	sec, usec, counter;
-	long 			delay;
+	struct timespec	deadline, now;
+	uint64			period;
+	int64			late;
+	uint32			missed;
 
 	ctx = (struct Client_CTX*)arg;
 
-	counter = 0;
-	gettimeofday(&first_tv, NULL);
+	thread_sched_setup("timer", ctx->timer_cpus, ctx->rt_priority);
 
-	while(1) {
-		gettimeofday(&current_tv, NULL);
+	/* Frames follow sending of previous frame */
+	if(ctx->flags & VC_VIRTUAL_CLOCK) {
+		timer_virtual_loop();
+		return NULL;
+	}
 
-		usec = (counter+1)*(ONE_SECOND/ctx->verse.fps);
+	period = (uint64)(ONE_SECOND_NSEC/(ctx->verse.fps*ctx->time_scale));
 
-		sec = usec / ONE_SECOND;
-		usec = usec % ONE_SECOND;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
 
-		expected_tv.tv_sec = first_tv.tv_sec + sec;
-		expected_tv.tv_usec = first_tv.tv_usec + usec;
+	while(1) {
+		timer_add_nsec(&deadline, period);
 
-		sec = expected_tv.tv_sec - current_tv.tv_sec;
-		usec = expected_tv.tv_usec - current_tv.tv_usec;
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {}
 
-		delay = ONE_SECOND*sec + usec;
+		clock_gettime(CLOCK_MONOTONIC, &now);
 
-		if(delay>0) {
-			counter++;
-		} else {
-			/* When packing and sending of packet took more then DELAY, then
-			 * crop delay and change counter and frame to corresponding
-			 * values */
-			delay = (-delay)%(ONE_SECOND/ctx->verse.fps);
-			counter += 1 + (-delay)/(ONE_SECOND/ctx->verse.fps);
+		late = timer_diff_nsec(&now, &deadline);
+		if(late < 0) {
+			late = 0;
 		}
 
-		usleep(delay);
-
-		for(sender = (struct Particle_Sender*)ctx->senders.first;
-				sender != NULL;
-				sender = sender->next)
-		{
-			pthread_mutex_lock(&sender->timer->mutex);
-
-			if(sender->timer->run == 1) {
-				if(delay>0) {
-					sender->timer->tot_frame++;
-				} else {
-					/* When packing/unpacking and sending/receiving of packet took
-					 * more then DELAY, then crop delay and change counter and
-					 * frame to corresponding values */
-					sender->timer->tot_frame += 1 + (-delay)/(ONE_SECOND/ctx->verse.fps);
-				}
-
-				/* Crop frame to be in limit:  <0, frame_count-1> */
-				if(sender->timer->tot_frame < 0) {
-					sender->timer->frame = 0;
-				} else {
-					sender->timer->frame = sender->timer->tot_frame % (ctx->pd->frame_count -1);
-				}
-			}
-
-			pthread_mutex_unlock(&sender->timer->mutex);
+		/* When sending or receiving of packets took more then one frame, then
+		 * skip missed frames and move deadline to the last of them */
+		missed = (uint32)(late / period);
+		if(missed > 0) {
+			timer_add_nsec(&deadline, missed*period);
 		}
 
-		/*printf("frame: %d\n", ctx->timer->tot_frame);*/
+		__atomic_add_fetch(&timer_stats.ticks, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&timer_stats.missed, missed, __ATOMIC_RELAXED);
+		stats_hist_add(&timer_stats.lateness, (uint32)(late/1000));
+
+		/* Advance all running timers at once */
+		__atomic_add_fetch(&timer_tick, 1 + missed, __ATOMIC_RELEASE);
 
-		sem_post(&ctx->timer_sem);
+		tick_broadcast((uint64)deadline.tv_sec*ONE_SECOND + deadline.tv_nsec/1000);
 	}
 
 	return NULL;
@@ -0,0 +1,197 @@
+/*
+ * $Id$
+ *
+ * ***** BEGIN BSD LICENSE BLOCK *****
+ *
+ * Copyright (c) 2009-2011, Jiri Hnidek
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ***** END BSD LICENSE BLOCK *****
+ *
+ * Authors: Jiri Hnidek <jiri.hnidek@tul.cz>
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "worker_pool.h"
+
+/**
+ * \brief Main loop of one worker thread
+ */
+static void *worker_loop(void *arg)
+{
+	struct Worker *worker = (struct Worker*)arg;
+	struct WorkerPool *pool = worker->pool;
+	uint32 last_job_id = 0;
+	WorkerPoolFunc func;
+	void *func_arg;
+
+	while(1) {
+		pthread_mutex_lock(&pool->mutex);
+
+		/* Wait for new job */
+		while(pool->run == 1 && pool->job_id == last_job_id) {
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+		}
+
+		if(pool->run == 0) {
+			pthread_mutex_unlock(&pool->mutex);
+			break;
+		}
+
+		last_job_id = pool->job_id;
+		func = pool->func;
+		func_arg = pool->arg;
+
+		pthread_mutex_unlock(&pool->mutex);
+
+		/* Do part of the job belonging to this worker */
+		func(func_arg, worker->id, pool->worker_count);
+
+		pthread_mutex_lock(&pool->mutex);
+		pool->busy_count--;
+		if(pool->busy_count == 0) {
+			pthread_cond_signal(&pool->done_cond);
+		}
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	return NULL;
+}
+
+/**
+ * \brief This function executes job by all workers and it waits until all
+ * workers finish their part of the job
+ */
+void worker_pool_run(struct WorkerPool *pool, WorkerPoolFunc func, void *arg)
+{
+	/* Single worker is executed in this thread */
+	if(pool->workers == NULL) {
+		func(arg, 0, 1);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+
+	pool->func = func;
+	pool->arg = arg;
+	pool->busy_count = pool->worker_count;
+	pool->job_id++;
+
+	pthread_cond_broadcast(&pool->work_cond);
+
+	while(pool->busy_count > 0) {
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+/**
+ * \brief This function stops and joins all worker threads
+ */
+static void stop_workers(struct WorkerPool *pool)
+{
+	int i;
+
+	if(pool->workers != NULL) {
+		pthread_mutex_lock(&pool->mutex);
+		pool->run = 0;
+		pthread_cond_broadcast(&pool->work_cond);
+		pthread_mutex_unlock(&pool->mutex);
+
+		for(i=0; i<pool->worker_count; i++) {
+			pthread_join(pool->workers[i].thread, NULL);
+		}
+
+		free(pool->workers);
+		pool->workers = NULL;
+	}
+}
+
+/**
+ * \brief This function stops all worker threads and free pool
+ */
+void free_worker_pool(struct WorkerPool *pool)
+{
+	stop_workers(pool);
+
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->mutex);
+}
+
+/**
+ * \brief This function creates pool of worker threads
+ */
+struct WorkerPool *create_worker_pool(uint16 worker_count)
+{
+	struct WorkerPool *pool;
+	int i;
+
+	pool = (struct WorkerPool*)malloc(sizeof(struct WorkerPool));
+
+	if(pool != NULL) {
+		pthread_mutex_init(&pool->mutex, NULL);
+		pthread_cond_init(&pool->work_cond, NULL);
+		pthread_cond_init(&pool->done_cond, NULL);
+		pool->job_id = 0;
+		pool->busy_count = 0;
+		pool->worker_count = (worker_count > 0) ? worker_count : 1;
+		pool->run = 1;
+		pool->func = NULL;
+		pool->arg = NULL;
+		pool->workers = NULL;
+
+		/* Threads are created only for more then one worker */
+		if(pool->worker_count > 1) {
+			pool->workers = (struct Worker*)calloc(pool->worker_count, sizeof(struct Worker));
+			if(pool->workers != NULL) {
+				for(i=0; i<pool->worker_count; i++) {
+					pool->workers[i].id = i;
+					pool->workers[i].pool = pool;
+					if(pthread_create(&pool->workers[i].thread, NULL, worker_loop, (void*)&pool->workers[i]) != 0) {
+						printf("ERROR: unable to create worker thread: %d\n", i);
+						/* Use only workers created so far */
+						pool->worker_count = i;
+						break;
+					}
+				}
+			}
+
+			/* Fallback to single worker executed in calling thread */
+			if(pool->workers == NULL || pool->worker_count < 2) {
+				stop_workers(pool);
+				pool->worker_count = 1;
+				pool->run = 1;
+			}
+		}
+	}
+
+	return pool;
+}